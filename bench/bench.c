@@ -0,0 +1,490 @@
+// Бенчмарки листинга: каждый случай выполняется в отдельном процессе,
+// результат - одна строка JSON на случай в stdout
+//
+// bench [--runs N] [--micro N] FLAT_DIR TREE_DIR
+//   FLAT_DIR - плоская директория, TREE_DIR - дерево для -R и `**`
+//   --runs N  число замеров на случай, в отчет идут медиана и минимум (5)
+//   --micro N число элементов в микробенчмарках, 0 - не запускать их (1000000)
+//
+// Поля отчета:
+//   case, flags        - имя случая и соответствующие флаги hw2
+//   entries            - число записей, на которое нормируются остальные поля
+//   ns_per_entry       - медиана времени ListPaths (вместе с раскрытием шаблонов)
+//   ns_per_entry_min   - минимум
+//   syscalls_per_entry - число системных вызовов за один прогон (через ptrace), null если недоступно
+//   peak_rss_kb        - пиковый RSS процесса со всеми прогонами
+//   vector_allocs_per_entry - выделения памяти векторами (пути, совпадения шаблонов,
+//                        поддиректории -R) за один прогон
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/dirscan.h"
+#include "../src/entry_store.h"
+#include "../src/glob.h"
+#include "../src/idcache.h"
+#include "../src/ls.h"
+#include "../src/sort.h"
+#include "../src/timefmt.h"
+#include "../src/vector.h"
+
+#define MAX_RUNS 64
+
+// Значения по умолчанию, как в main.c
+#define ARGS(...) {.sort = SORT_NAME, .jobs = 1, .timeStyle = TIME_STYLE_DEFAULT, __VA_ARGS__}
+
+enum {
+    ON_FLAT,
+    ON_TREE,
+};
+
+typedef struct BenchCase {
+    const char *name;
+    const char *flags;
+    int fixture;           // ON_FLAT или ON_TREE
+    const char *pattern;   // Аргумент относительно фикстуры, NULL - сама фикстура
+    bool recursive_count;  // Нормировать на все записи дерева
+    ListArgs args;
+} BenchCase;
+
+static const BenchCase cases[] = {
+    {"plain", "", ON_FLAT, NULL, false, ARGS()},
+    {"long", "-l", ON_FLAT, NULL, false, ARGS(.longFormat = true)},
+    {"jsonl", "--format=jsonl", ON_FLAT, NULL, false, ARGS(.format = FORMAT_JSONL)},
+    {"long-stats", "-l --stats", ON_FLAT, NULL, false, ARGS(.longFormat = true, .stats = true)},
+    {"long-human", "-l -h", ON_FLAT, NULL, false, ARGS(.longFormat = true, .humanReadable = true)},
+    {"size-sort", "-S", ON_FLAT, NULL, false, ARGS(.sort = SORT_SIZE)},
+    {"time-sort", "-t", ON_FLAT, NULL, false, ARGS(.sort = SORT_TIME)},
+    {"top-20-size", "-S --top 20", ON_FLAT, NULL, false, ARGS(.sort = SORT_SIZE, .top = 20)},
+    {"top-20-time-long", "-l -t --top 20", ON_FLAT, NULL, false, ARGS(.longFormat = true, .sort = SORT_TIME, .top = 20)},
+    {"long-time-sort-reverse", "-l -t -r", ON_FLAT, NULL, false, ARGS(.longFormat = true, .sort = SORT_TIME, .reverse = true)},
+    {"blocks", "-s", ON_FLAT, NULL, false, ARGS(.size = true)},
+    {"unsorted-long", "-U -l", ON_FLAT, NULL, false, ARGS(.longFormat = true, .sort = SORT_NONE)},
+    {"long-jobs-2", "-l --jobs 2", ON_FLAT, NULL, false, ARGS(.longFormat = true, .jobs = 2)},
+    {"long-jobs-4", "-l --jobs 4", ON_FLAT, NULL, false, ARGS(.longFormat = true, .jobs = 4)},
+    {"long-jobs-8", "-l --jobs 8", ON_FLAT, NULL, false, ARGS(.longFormat = true, .jobs = 8)},
+    {"long-io-uring", "-l --io-uring", ON_FLAT, NULL, false, ARGS(.longFormat = true, .ioUring = true)},
+    {"glob", "-d '*a*'", ON_FLAT, "*a*", false, ARGS(.directory = true)},
+    {"glob-classes", "-d '[a-m]*[0-9]'", ON_FLAT, "[a-m]*[0-9]", false, ARGS(.directory = true)},
+    {"glob-globstar", "-d '**/*x*'", ON_TREE, "**/*x*", true, ARGS(.directory = true)},
+    {"recursive", "-R", ON_TREE, NULL, true, ARGS(.recursive = true)},
+    {"recursive-long", "-R -l", ON_TREE, NULL, true, ARGS(.recursive = true, .longFormat = true)},
+    {"recursive-jobs-4", "-R --jobs 4", ON_TREE, NULL, true, ARGS(.recursive = true, .jobs = 4)},
+    {"du", "--du", ON_TREE, NULL, true, ARGS(.du = true, .size = true)},
+    {"du-jobs-4", "--du --jobs 4", ON_TREE, NULL, true, ARGS(.du = true, .size = true, .jobs = 4)},
+};
+
+typedef struct BenchResult {
+    double ns_median;
+    double ns_min;
+    double vector_allocs;
+} BenchResult;
+
+static double NowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int CompareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Число записей директории (рекурсивно - всего дерева), без "." и ".."
+static size_t CountEntries(const char *path, bool recursive) {
+    DirReader reader;
+    if (!OpenDirReader(&reader, path)) return 0;
+    size_t count = 0;
+    RawDirEntry entry;
+    while (ReadDirEntry(&reader, &entry) > 0) {
+        if (strcmp(entry.name, ".") == 0 || strcmp(entry.name, "..") == 0) continue;
+        count++;
+        if (recursive && entry.type == DT_DIR) {
+            char *child = malloc(strlen(path) + entry.name_len + 2);
+            if (!child) break;
+            sprintf(child, "%s/%s", path, entry.name);
+            count += CountEntries(child, true);
+            free(child);
+        }
+    }
+    CloseDirReader(&reader);
+    return count;
+}
+
+// Один прогон листинга, как его делает main: раскрытие шаблонов и ListPaths
+static void RunListing(const BenchCase *bench, const char *fixture, FILE *out) {
+    GenericVector *paths = NewArenaVector(1);
+    const char *path = bench->pattern ? bench->pattern : fixture;
+    if (!paths || !AppendString(paths, path, strlen(path))) {
+        fprintf(stderr, "bench: memory allocation failed\n");
+        _exit(EXIT_FAILURE);
+    }
+    ExpandPathsWithGlob(paths);
+    ListStats stats;
+    if (ListPathsWithStats(paths, &bench->args, out, bench->args.stats ? &stats : NULL) != LIST_SUCCESS) {
+        fprintf(stderr, "bench: %s: listing failed\n", bench->name);
+    }
+    FreeGenericVector(paths);
+    // Каждый прогон начинает с пустого кэша имен, как отдельный запуск hw2
+    FreeIdCache();
+}
+
+static void PrepareChild(const BenchCase *bench, const char *fixture) {
+    // Шаблоны раскрываются относительно фикстуры
+    if (bench->pattern && chdir(fixture) != 0) {
+        fprintf(stderr, "bench: cannot enter %s: %s\n", fixture, strerror(errno));
+        _exit(EXIT_FAILURE);
+    }
+}
+
+// Замер времени в дочернем процессе; пиковый RSS берется из wait4
+static bool TimeCase(const BenchCase *bench, const char *fixture, int runs, BenchResult *result, long *peak_rss_kb) {
+    // Первым по каналу идет число выделений векторами за прогрев, затем замеры
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        close(fds[0]);
+        PrepareChild(bench, fixture);
+        FILE *out = fopen("/dev/null", "w");
+        if (!out) _exit(EXIT_FAILURE);
+
+        size_t allocs = GetVectorAllocations();
+        RunListing(bench, fixture, out);  // Прогрев
+        double samples[MAX_RUNS + 1];
+        samples[0] = (double)(GetVectorAllocations() - allocs);
+        for (int i = 1; i <= runs; i++) {
+            double start = NowNs();
+            RunListing(bench, fixture, out);
+            samples[i] = NowNs() - start;
+        }
+        fclose(out);
+        ssize_t written = write(fds[1], samples, (runs + 1) * sizeof(double));
+        _exit(written == (ssize_t)((runs + 1) * sizeof(double)) ? 0 : EXIT_FAILURE);
+    }
+
+    close(fds[1]);
+    double samples[MAX_RUNS + 1];
+    size_t size = (runs + 1) * sizeof(double);
+    size_t got = 0;
+    ssize_t n;
+    while (got < size && (n = read(fds[0], (char *)samples + got, size - got)) > 0) {
+        got += (size_t)n;
+    }
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || got != size) {
+        return false;
+    }
+    result->vector_allocs = samples[0];
+    qsort(samples + 1, runs, sizeof(double), CompareDoubles);
+    result->ns_min = samples[1];
+    result->ns_median = samples[1 + runs / 2];
+    *peak_rss_kb = usage.ru_maxrss;
+    return true;
+}
+
+// Подсчет системных вызовов одного прогона через ptrace (вместе с потоками)
+// Возвращает -1, если трассировка недоступна
+static long CountSyscalls(const BenchCase *bench, const char *fixture) {
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        PrepareChild(bench, fixture);
+        FILE *out = fopen("/dev/null", "w");
+        if (!out) _exit(EXIT_FAILURE);
+        if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0) _exit(EXIT_FAILURE);
+        raise(SIGSTOP);
+        RunListing(bench, fixture, out);
+        _exit(0);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status)) {
+        waitpid(pid, &status, 0);
+        return -1;
+    }
+    long options = PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL;
+    if (ptrace(PTRACE_SETOPTIONS, pid, NULL, (void *)options) != 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+        return -1;
+    }
+    ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+
+    // Каждый вызов дает остановку на входе и на выходе
+    long stops = 0;
+    for (;;) {
+        pid_t tid = waitpid(-1, &status, __WALL);
+        if (tid < 0) break;
+        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+            if (tid == pid) break;
+            continue;
+        }
+        if (!WIFSTOPPED(status)) continue;
+
+        int sig = WSTOPSIG(status);
+        int inject = 0;
+        if (sig == (SIGTRAP | 0x80)) {
+            stops++;
+        } else if (sig != SIGTRAP && sig != SIGSTOP) {
+            // SIGTRAP - событие clone, SIGSTOP - начальная остановка нового потока
+            inject = sig;
+        }
+        ptrace(PTRACE_SYSCALL, tid, NULL, (void *)(long)inject);
+    }
+    return (stops + 1) / 2;
+}
+
+
+// Микробенчмарки отдельных компонентов; возвращают суммарное время в нс
+
+static uint64_t bench_rng = 88172645463325252ULL;
+
+static uint64_t NextRandom(void) {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 7;
+    bench_rng ^= bench_rng << 17;
+    return bench_rng;
+}
+
+static double MicroSort(size_t n, int sort) {
+    EntryStore store;
+    InitEntryStore(&store);
+    char name[32];
+    for (size_t i = 0; i < n; i++) {
+        struct stat st;
+        memset(&st, 0, sizeof(st));
+        st.st_size = (off_t)(NextRandom() % (1ULL << (NextRandom() % 40)));
+        st.st_mtim.tv_sec = (time_t)(1600000000 + NextRandom() % 100000000);
+        st.st_mtim.tv_nsec = (long)(NextRandom() % 1000000000);
+        int len = snprintf(name, sizeof(name), "f%016llx", (unsigned long long)NextRandom());
+        if (!AddEntry(&store, name, (size_t)len, &st)) {
+            fprintf(stderr, "bench: memory allocation failed\n");
+            _exit(EXIT_FAILURE);
+        }
+    }
+    ListArgs args = ARGS(.sort = sort);
+    double start = NowNs();
+    const FileEntry **order = SortEntries(store.entries, store.count, &args);
+    double elapsed = NowNs() - start;
+    free(order);
+    FreeEntryStore(&store);
+    return elapsed;
+}
+
+static double MicroSortName(size_t n) { return MicroSort(n, SORT_NAME); }
+static double MicroSortSize(size_t n) { return MicroSort(n, SORT_SIZE); }
+static double MicroSortTime(size_t n) { return MicroSort(n, SORT_TIME); }
+
+// Патологический для перебора с возвратами шаблон на длинных именах из 'a'
+static double MicroGlob(size_t n) {
+    char name[64];
+    memset(name, 'a', sizeof(name));
+    unsigned char *lengths = malloc(n);
+    GlobPattern glob;
+    if (!lengths || !CompileGlob(&glob, "*a*a*a*a*a*b")) _exit(EXIT_FAILURE);
+    for (size_t i = 0; i < n; i++) {
+        lengths[i] = (unsigned char)(20 + NextRandom() % 40);
+    }
+    size_t matches = 0;
+    double start = NowNs();
+    for (size_t i = 0; i < n; i++) {
+        matches += MatchGlob(&glob, name, lengths[i]);
+    }
+    double elapsed = NowNs() - start;
+    FreeGlob(&glob);
+    free(lengths);
+    return matches ? -1 : elapsed;
+}
+
+static double MicroTimestamp(size_t n) {
+    char buf[TIMESTAMP_MAX];
+    time_t base = time(NULL) - 30 * 86400;
+    size_t total = 0;
+    double start = NowNs();
+    for (size_t i = 0; i < n; i++) {
+        struct timespec when = {base + (time_t)(NextRandom() % (30 * 86400)), 0};
+        total += FormatTimestamp(buf, sizeof(buf), &when, TIME_STYLE_DEFAULT, NULL);
+    }
+    double elapsed = NowNs() - start;
+    return total ? elapsed : -1;
+}
+
+// Размеры с логарифмически равномерным распределением, через -h и --si поочередно
+static double MicroFormatSize(size_t n) {
+    char buf[HUMAN_SIZE_MAX];
+    size_t total = 0;
+    double start = NowNs();
+    for (size_t i = 0; i < n; i++) {
+        unsigned long long size = NextRandom() >> (NextRandom() % 64);
+        total += FormatSize(buf, size, i & 1);
+    }
+    double elapsed = NowNs() - start;
+    return total ? elapsed : -1;
+}
+
+// Прежний FormatSize через double и snprintf - точка отсчета для micro-format-size
+static size_t FormatSizeSnprintf(char *buf, size_t bufsize, unsigned long long size, bool si) {
+    double formatted = (double)size;
+    int divisor = si ? 1000 : 1024;
+    const char *units[] = {"", si ? "k" : "K", "M", "G", "T"};
+    size_t unit = 0;
+    while (formatted >= divisor && unit < sizeof(units) / sizeof(units[0]) - 1) {
+        formatted /= divisor;
+        unit++;
+    }
+    if (formatted >= 10) {
+        return (size_t)snprintf(buf, bufsize, "%.0f%s", formatted, units[unit]);
+    }
+    formatted = (formatted * 10 + 0.5) / 10.0;
+    bool whole = formatted - (double)(long long)formatted < 0.1;
+    return (size_t)snprintf(buf, bufsize, (whole && unit == 0) ? "%.0f%s" : "%.1f%s", formatted, units[unit]);
+}
+
+static double MicroFormatSizeSnprintf(size_t n) {
+    char buf[64];
+    size_t total = 0;
+    double start = NowNs();
+    for (size_t i = 0; i < n; i++) {
+        unsigned long long size = NextRandom() >> (NextRandom() % 64);
+        total += FormatSizeSnprintf(buf, sizeof(buf), size, i & 1);
+    }
+    double elapsed = NowNs() - start;
+    return total ? elapsed : -1;
+}
+
+typedef struct MicroCase {
+    const char *name;
+    double (*run)(size_t n);
+} MicroCase;
+
+static const MicroCase micro_cases[] = {
+    {"micro-sort-name", MicroSortName},
+    {"micro-sort-size", MicroSortSize},
+    {"micro-sort-time", MicroSortTime},
+    {"micro-glob-pathological", MicroGlob},
+    {"micro-timestamp", MicroTimestamp},
+    {"micro-format-size", MicroFormatSize},
+    {"micro-format-size-snprintf", MicroFormatSizeSnprintf},
+};
+
+static bool TimeMicro(const MicroCase *micro, size_t n, double *ns, long *peak_rss_kb) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        close(fds[0]);
+        double elapsed = micro->run(n);
+        _exit(write(fds[1], &elapsed, sizeof(elapsed)) == sizeof(elapsed) ? 0 : EXIT_FAILURE);
+    }
+    close(fds[1]);
+    ssize_t got = read(fds[0], ns, sizeof(*ns));
+    close(fds[0]);
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || got != sizeof(*ns) || *ns < 0) {
+        return false;
+    }
+    *peak_rss_kb = usage.ru_maxrss;
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    int runs = 5;
+    size_t micro_n = 1000000;
+    const char *fixtures[2] = {NULL, NULL};
+    int fixture_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--micro") == 0 && i + 1 < argc) {
+            micro_n = strtoull(argv[++i], NULL, 10);
+        } else if (argv[i][0] != '-' && fixture_count < 2) {
+            fixtures[fixture_count++] = argv[i];
+        } else {
+            fixture_count = 0;
+            break;
+        }
+    }
+    if (fixture_count != 2 || runs < 1 || runs > MAX_RUNS) {
+        fprintf(stderr, "Usage: bench [--runs N] [--micro N] FLAT_DIR TREE_DIR\n");
+        return EXIT_FAILURE;
+    }
+    // Абсолютные пути: шаблоны раскрываются после chdir в фикстуру
+    char *roots[2];
+    for (int i = 0; i < 2; i++) {
+        roots[i] = realpath(fixtures[i], NULL);
+        if (!roots[i]) {
+            fprintf(stderr, "bench: %s: %s\n", fixtures[i], strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const BenchCase *bench = &cases[i];
+        const char *fixture = roots[bench->fixture];
+        size_t entries = CountEntries(fixture, bench->recursive_count);
+        if (entries == 0) entries = 1;
+
+        BenchResult result;
+        long rss = 0;
+        if (!TimeCase(bench, fixture, runs, &result, &rss)) {
+            fprintf(stderr, "bench: %s failed\n", bench->name);
+            failures++;
+            continue;
+        }
+        long syscalls = CountSyscalls(bench, fixture);
+
+        printf("{\"case\":\"%s\",\"flags\":\"%s\",\"entries\":%zu,\"ns_per_entry\":%.1f,\"ns_per_entry_min\":%.1f,",
+               bench->name, bench->flags, entries, result.ns_median / entries, result.ns_min / entries);
+        if (syscalls >= 0) {
+            printf("\"syscalls_per_entry\":%.3f,", (double)syscalls / entries);
+        } else {
+            printf("\"syscalls_per_entry\":null,");
+        }
+        printf("\"peak_rss_kb\":%ld,\"vector_allocs_per_entry\":%.3f}\n", rss, result.vector_allocs / entries);
+        fflush(stdout);
+    }
+
+    for (size_t i = 0; micro_n > 0 && i < sizeof(micro_cases) / sizeof(micro_cases[0]); i++) {
+        double ns;
+        long rss = 0;
+        if (!TimeMicro(&micro_cases[i], micro_n, &ns, &rss)) {
+            fprintf(stderr, "bench: %s failed\n", micro_cases[i].name);
+            failures++;
+            continue;
+        }
+        printf("{\"case\":\"%s\",\"flags\":\"\",\"entries\":%zu,\"ns_per_entry\":%.1f,\"ns_per_entry_min\":%.1f,"
+               "\"syscalls_per_entry\":null,\"peak_rss_kb\":%ld,\"vector_allocs_per_entry\":null}\n",
+               micro_cases[i].name, micro_n, ns / micro_n, ns / micro_n, rss);
+        fflush(stdout);
+    }
+
+    free(roots[0]);
+    free(roots[1]);
+    return failures ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,250 @@
+// Генератор синтетических деревьев для бенчмарков
+//
+// gentree [options] DIR
+//   --entries N        число файлов и ссылок во всем дереве (по умолчанию 10000)
+//   --depth D          глубина дерева поддиректорий, 0 - плоская директория (0)
+//   --fanout F         число поддиректорий в каждой директории выше глубины D (4)
+//   --name-len MIN:MAX диапазон длины имен (8:24)
+//   --name-dist DIST   uniform - равномерно, short - геометрически смещено к MIN (uniform)
+//   --symlinks RATIO   доля символических ссылок среди записей, от 0 до 1 (0.1)
+//   --owners N         число разных uid/gid (1000..1000+N-1), 0 - не менять владельца (0)
+//   --seed S           зерно генератора; одинаковые параметры дают одинаковое дерево (1)
+//
+// Файлы разреженные (размер задается ftruncate), время изменения случайно в пределах двух лет
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TWO_YEARS (2LL * 365 * 24 * 3600)
+
+typedef struct GenOptions {
+    size_t entries;
+    int depth;
+    int fanout;
+    int name_min;
+    int name_max;
+    bool name_short;
+    double symlinks;
+    int owners;
+    uint64_t seed;
+} GenOptions;
+
+typedef struct GenState {
+    const GenOptions *opts;
+    uint64_t rng;
+    size_t files_per_dir;
+    size_t files_left;
+    size_t dirs_left;
+    time_t now;
+    bool chown_failed;
+    size_t created;
+} GenState;
+
+// xorshift64*: результат не зависит от libc
+static uint64_t NextRandom(GenState *state) {
+    state->rng ^= state->rng >> 12;
+    state->rng ^= state->rng << 25;
+    state->rng ^= state->rng >> 27;
+    return state->rng * 2685821657736338717ULL;
+}
+
+static double NextUnit(GenState *state) {
+    return (double)(NextRandom(state) >> 11) / (double)(1ULL << 53);
+}
+
+static int NameLength(GenState *state) {
+    const GenOptions *opts = state->opts;
+    int span = opts->name_max - opts->name_min;
+    if (span <= 0) return opts->name_min;
+    if (!opts->name_short) {
+        return opts->name_min + (int)(NextRandom(state) % (uint64_t)(span + 1));
+    }
+    // Геометрическое распределение с p = 1/4, обрезанное по MAX
+    int len = opts->name_min;
+    while (len < opts->name_max && NextRandom(state) % 4 != 0) len++;
+    return len;
+}
+
+// Случайное имя с уникальным суффиксом из номера записи в системе счисления 36
+static void MakeName(GenState *state, size_t index, char *name) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-.";
+    static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    char suffix[16];
+    int suffix_len = 0;
+    do {
+        suffix[suffix_len++] = digits[index % 36];
+        index /= 36;
+    } while (index > 0);
+
+    int len = NameLength(state);
+    if (len < suffix_len + 1) len = suffix_len + 1;
+    int prefix_len = len - suffix_len;
+    for (int i = 0; i < prefix_len; i++) {
+        // Имена не начинаются с точки, чтобы все записи были видны без -a
+        name[i] = alphabet[NextRandom(state) % (i == 0 ? 62 : sizeof(alphabet) - 1)];
+    }
+    for (int i = 0; i < suffix_len; i++) {
+        name[prefix_len + i] = suffix[suffix_len - 1 - i];
+    }
+    name[len] = '\0';
+}
+
+static void SetOwnerAndTime(GenState *state, int dirfd, const char *name) {
+    const GenOptions *opts = state->opts;
+    if (opts->owners > 0 && !state->chown_failed) {
+        uid_t uid = 1000 + (uid_t)(NextRandom(state) % (uint64_t)opts->owners);
+        gid_t gid = 1000 + (gid_t)(NextRandom(state) % (uint64_t)opts->owners);
+        if (fchownat(dirfd, name, uid, gid, AT_SYMLINK_NOFOLLOW) != 0) {
+            fprintf(stderr, "gentree: cannot change owners (%s), keeping the current ones\n", strerror(errno));
+            state->chown_failed = true;
+        }
+    }
+    struct timespec times[2];
+    times[0].tv_sec = times[1].tv_sec = state->now - (time_t)(NextRandom(state) % TWO_YEARS);
+    times[0].tv_nsec = times[1].tv_nsec = (long)(NextRandom(state) % 1000000000ULL);
+    utimensat(dirfd, name, times, AT_SYMLINK_NOFOLLOW);
+}
+
+static bool FillDirectory(GenState *state, const char *path, int level) {
+    int dirfd = open(path, O_RDONLY | O_DIRECTORY);
+    if (dirfd < 0) {
+        fprintf(stderr, "gentree: cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    // Последняя директория забирает остаток
+    size_t count = (state->dirs_left == 1) ? state->files_left : state->files_per_dir;
+    state->files_left -= count;
+    state->dirs_left--;
+
+    char name[256];
+    char first[256] = "";
+    for (size_t i = 0; i < count; i++) {
+        MakeName(state, state->created++, name);
+        if (first[0] != '\0' && NextUnit(state) < state->opts->symlinks) {
+            if (symlinkat(first, dirfd, name) != 0) goto fail;
+        } else {
+            int fd = openat(dirfd, name, O_WRONLY | O_CREAT | O_EXCL, 0644);
+            if (fd < 0) goto fail;
+            // Размеры от 0 до 1 ГиБ с равномерным распределением порядка величины
+            off_t size = (off_t)(NextRandom(state) % (1ULL << (NextRandom(state) % 31)));
+            int rc = ftruncate(fd, size);
+            close(fd);
+            if (rc != 0) goto fail;
+            if (first[0] == '\0') strcpy(first, name);
+        }
+        SetOwnerAndTime(state, dirfd, name);
+    }
+
+    for (int i = 0; level < state->opts->depth && i < state->opts->fanout; i++) {
+        MakeName(state, state->created++, name);
+        if (mkdirat(dirfd, name, 0755) != 0) goto fail;
+        char *child = malloc(strlen(path) + strlen(name) + 2);
+        if (!child) goto fail;
+        sprintf(child, "%s/%s", path, name);
+        bool ok = FillDirectory(state, child, level + 1);
+        free(child);
+        if (!ok) {
+            close(dirfd);
+            return false;
+        }
+        SetOwnerAndTime(state, dirfd, name);
+    }
+    close(dirfd);
+    return true;
+
+fail:
+    fprintf(stderr, "gentree: cannot create %s/%s: %s\n", path, name, strerror(errno));
+    close(dirfd);
+    return false;
+}
+
+static void Usage(void) {
+    fprintf(stderr, "Usage: gentree [--entries N] [--depth D] [--fanout F] [--name-len MIN:MAX]\n"
+                    "               [--name-dist uniform|short] [--symlinks RATIO] [--owners N] [--seed S] DIR\n");
+}
+
+int main(int argc, char **argv) {
+    GenOptions opts = {
+        .entries = 10000,
+        .depth = 0,
+        .fanout = 4,
+        .name_min = 8,
+        .name_max = 24,
+        .name_short = false,
+        .symlinks = 0.1,
+        .owners = 0,
+        .seed = 1,
+    };
+    const char *root = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--entries") == 0 && value) {
+            opts.entries = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--depth") == 0 && value) {
+            opts.depth = atoi(value);
+        } else if (strcmp(argv[i], "--fanout") == 0 && value) {
+            opts.fanout = atoi(value);
+        } else if (strcmp(argv[i], "--name-len") == 0 && value) {
+            if (sscanf(value, "%d:%d", &opts.name_min, &opts.name_max) != 2) {
+                Usage();
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--name-dist") == 0 && value) {
+            opts.name_short = (strcmp(value, "short") == 0);
+        } else if (strcmp(argv[i], "--symlinks") == 0 && value) {
+            opts.symlinks = atof(value);
+        } else if (strcmp(argv[i], "--owners") == 0 && value) {
+            opts.owners = atoi(value);
+        } else if (strcmp(argv[i], "--seed") == 0 && value) {
+            opts.seed = strtoull(value, NULL, 10);
+        } else if (argv[i][0] != '-' && !root) {
+            root = argv[i];
+            continue;
+        } else {
+            Usage();
+            return EXIT_FAILURE;
+        }
+        i++;
+    }
+    if (!root || opts.depth < 0 || opts.fanout < 1 || opts.name_min < 1 || opts.name_max > 200 || opts.name_min > opts.name_max) {
+        Usage();
+        return EXIT_FAILURE;
+    }
+
+    GenState state = {
+        .opts = &opts,
+        .rng = opts.seed ? opts.seed : 1,
+        .files_left = opts.entries,
+        .now = time(NULL),
+    };
+    // Число директорий: 1 + F + F^2 + ... + F^D
+    size_t dirs = 1, level_dirs = 1;
+    for (int level = 0; level < opts.depth; level++) {
+        level_dirs *= (size_t)opts.fanout;
+        dirs += level_dirs;
+    }
+    state.dirs_left = dirs;
+    state.files_per_dir = opts.entries / dirs;
+
+    if (mkdir(root, 0755) != 0) {
+        fprintf(stderr, "gentree: cannot create %s: %s\n", root, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (!FillDirectory(&state, root, 0)) {
+        return EXIT_FAILURE;
+    }
+    printf("gentree: %s: %zu entries in %zu directories\n", root, opts.entries, dirs);
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,6 +6,8 @@
 
 #include "src/vector.h"
 #include "src/ls.h"
+#include "src/idcache.h"
+#include "src/watch.h"
 
 void InitListArgs(ListArgs *args) {
     args->all = false;
@@ -17,7 +20,68 @@ void InitListArgs(ListArgs *args) {
     args->size = false;
     args->reverse = false;
     args->longFormat = false;
-    args->sort = SORT_NONE;
+    args->recursive = false;
+    args->debug = false;
+    args->jobs = 1;
+    args->ioUring = false;
+    args->sort = SORT_NAME;
+    args->timeStyle = TIME_STYLE_DEFAULT;
+    args->timeFormat = NULL;
+    args->stats = false;
+    args->format = FORMAT_TEXT;
+    args->cacheDir = NULL;
+    args->watch = false;
+    args->du = false;
+    args->top = 0;
+}
+
+
+static void StopWatching(int signum) {
+    (void)signum;
+    watch_stop_requested = 1;
+}
+
+
+// SIGINT и SIGTERM завершают --watch штатно (со статистикой); повторный сигнал завершает
+// программу сразу. Сигналы блокируются до запуска потоков, и все потоки наследуют маску:
+// доставляются они только в ожидании событий (RunDirWatch), поэтому не теряются
+void InstallWatchSignals(void) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = StopWatching;
+    action.sa_flags = SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    sigset_t blocked;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigprocmask(SIG_BLOCK, &blocked, NULL);
+}
+
+
+// После слежения сигналы снова доставляются сразу
+void RestoreWatchSignals(void) {
+    sigset_t blocked;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigprocmask(SIG_UNBLOCK, &blocked, NULL);
+}
+
+
+// Вывод отладочных счетчиков (--debug)
+void PrintDebugStats(void) {
+    IdCacheStats users, groups;
+    GetIdCacheStats(&users, &groups);
+
+    size_t hits = users.hits + groups.hits;
+    size_t lookups = hits + users.misses + groups.misses;
+    fprintf(stderr, "idcache: users %zu hits / %zu misses, groups %zu hits / %zu misses, hit rate %.1f%%\n",
+            users.hits, users.misses, groups.hits, groups.misses, lookups ? 100.0 * hits / lookups : 0.0);
+    fprintf(stderr, "vectors: %zu allocations\n", GetVectorAllocations());
 }
 
 
@@ -33,7 +97,8 @@ int main(int argc, char **argv) {
     InitListArgs(&args);
 
     // Вектор для хранения путей
-    GenericVector *paths = NewGenericVector(1);
+    // Пути копируются в арену вектора, без отдельного выделения на каждый аргумент
+    GenericVector *paths = NewArenaVector((size_t)argc);
     if (!paths) {
         fprintf(stderr, "Failed to allocate memory for paths vector.\n");
         return EXIT_FAILURE;
@@ -80,8 +145,66 @@ int main(int argc, char **argv) {
                 args.sort = SORT_TIME;
             } else if (strcmp(argv[i], "-U") == 0) {
                 args.sort = SORT_NONE;
+            } else if (strcmp(argv[i], "-f") == 0) {
+                // Как в GNU ls: все записи без сортировки
+                args.all = true;
+                args.sort = SORT_NONE;
             } else if (strcmp(argv[i], "-l") == 0) {
                 args.longFormat = true;
+            } else if ((strcmp(argv[i], "--recursive") == 0) || (strcmp(argv[i], "-R") == 0)) {
+                args.recursive = true;
+            } else if ((strcmp(argv[i], "--jobs") == 0) && (i + 1) < argc) {
+                char *end;
+                long jobs = strtol(argv[i + 1], &end, 10);
+                if (*end != '\0' || jobs < 1 || jobs > 1024) {
+                    fprintf(stderr, "Invalid number of jobs: %s\n", argv[i + 1]);
+                    FreePaths(paths);
+                    return EXIT_FAILURE;
+                }
+                args.jobs = (int)jobs;
+                i++;
+            } else if (strncmp(argv[i], "--top=", 6) == 0 || ((strcmp(argv[i], "--top") == 0) && (i + 1) < argc)) {
+                const char *count = (argv[i][5] == '=') ? argv[i] + 6 : argv[++i];
+                char *end;
+                long long top = strtoll(count, &end, 10);
+                if (*count == '\0' || *end != '\0' || top < 1) {
+                    fprintf(stderr, "Invalid number of entries: %s\n", count);
+                    FreePaths(paths);
+                    return EXIT_FAILURE;
+                }
+                args.top = (size_t)top;
+            } else if (strncmp(argv[i], "--time-style=", 13) == 0 || ((strcmp(argv[i], "--time-style") == 0) && (i + 1) < argc)) {
+                const char *style = (argv[i][12] == '=') ? argv[i] + 13 : argv[++i];
+                if (ParseTimeStyle(style, &args.timeStyle, &args.timeFormat) != 0) {
+                    fprintf(stderr, "Unknown time style: %s\n", style);
+                    FreePaths(paths);
+                    return EXIT_FAILURE;
+                }
+            } else if (strncmp(argv[i], "--format=", 9) == 0 || ((strcmp(argv[i], "--format") == 0) && (i + 1) < argc)) {
+                const char *format = (argv[i][8] == '=') ? argv[i] + 9 : argv[++i];
+                if (strcmp(format, "jsonl") == 0) {
+                    args.format = FORMAT_JSONL;
+                } else if (strcmp(format, "nul") == 0) {
+                    args.format = FORMAT_NUL;
+                } else {
+                    fprintf(stderr, "Unknown format: %s\n", format);
+                    FreePaths(paths);
+                    return EXIT_FAILURE;
+                }
+            } else if (strncmp(argv[i], "--cache=", 8) == 0 || ((strcmp(argv[i], "--cache") == 0) && (i + 1) < argc)) {
+                args.cacheDir = (argv[i][7] == '=') ? argv[i] + 8 : argv[++i];
+            } else if (strcmp(argv[i], "--du") == 0) {
+                // Размеры поддеревьев выводятся в столбце блоков, как с -s
+                args.du = true;
+                args.size = true;
+            } else if (strcmp(argv[i], "--watch") == 0) {
+                args.watch = true;
+            } else if (strcmp(argv[i], "--io-uring") == 0) {
+                args.ioUring = true;
+            } else if (strcmp(argv[i], "--stats") == 0) {
+                args.stats = true;
+            } else if (strcmp(argv[i], "--debug") == 0) {
+                args.debug = true;
             } else {
                 fprintf(stderr, "Unknown argument: %s\n", argv[i]);
                 FreePaths(paths);
@@ -89,33 +212,44 @@ int main(int argc, char **argv) {
             }
         } else {
             // Считаем все остальные аргументы путями
-            char *path = strdup(argv[i]);
-            if (!path) {
+            if (!AppendString(paths, argv[i], strlen(argv[i]))) {
                 fprintf(stderr, "Failed to allocate memory for path.\n");
                 FreePaths(paths);
                 return EXIT_FAILURE;
             }
-            Append(paths, path);
             pathProvided = true;
         }
     }
 
     // Если не был указан путь, используем текущую директорию
     if (!pathProvided) {
-        char *defaultPath = strdup(".");
-        if (!defaultPath) {
+        if (!AppendString(paths, ".", 1)) {
             fprintf(stderr, "Failed to allocate memory for default path.\n");
             FreePaths(paths);
             return EXIT_FAILURE;
         }
-        Append(paths, defaultPath);
     }
 
     // Выполняем глоббинг
     ExpandPathsWithGlob(paths);
     
+    if (args.watch) {
+        InstallWatchSignals();
+    }
+
     // Вызов функции для обработки путей
-    ListErrorCode result = ListPaths(paths, &args, stdout);
+    ListStats stats;
+    ListErrorCode result = ListPathsWithStats(paths, &args, stdout, args.stats ? &stats : NULL);
+    if (args.watch) {
+        RestoreWatchSignals();
+    }
+    if (args.stats) {
+        PrintListStats(stderr, &stats);
+    }
+    if (args.debug) {
+        PrintDebugStats();
+    }
+    FreeIdCache();
     if (result != LIST_SUCCESS) {
         fprintf(stderr, "Error occurred during listing: %d\n", result);
         FreePaths(paths);
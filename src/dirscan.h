@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <linux/stat.h>
+
+// Directory reader on top of getdents64 with a large user buffer
+typedef struct DirReader {
+    int fd;
+    char *buf;
+    size_t buf_size;
+    size_t pos;
+    size_t len;
+} DirReader;
+
+// Single directory entry; name points into the reader buffer
+// and stays valid until the next ReadDirEntry call
+typedef struct RawDirEntry {
+    const char *name;
+    size_t name_len;
+    unsigned char type;  // DT_* value from d_type
+    ino_t ino;
+} RawDirEntry;
+
+// Open a directory for reading; returns false and sets errno on failure
+bool OpenDirReader(DirReader *reader, const char *path);
+// The same for a path relative to an open directory
+bool OpenDirReaderAt(DirReader *reader, int dirfd, const char *path);
+// Read the next entry: 1 - entry read, 0 - end of directory, -1 - error (errno is set)
+int ReadDirEntry(DirReader *reader, RawDirEntry *entry);
+// Close the directory and free the buffer
+void CloseDirReader(DirReader *reader);
+
+// stat an entry relative to an open directory via statx, requesting only the fields in mask
+// (STATX_* bits); unrequested fields of statbuf may be left zero. Returns 0 or -1 with errno set
+int StatAt(int dirfd, const char *name, bool follow_links, unsigned int mask, struct stat *statbuf);
+
+// Convert statx results to struct stat
+void StatxToStat(const struct statx *stx, struct stat *statbuf);
+
+// Convert d_type to the file type bits of st_mode (0 for DT_UNKNOWN)
+mode_t DirentTypeToMode(unsigned char type);
@@ -0,0 +1,346 @@
+#include "du.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "dirscan.h"
+#include "sort.h"
+#include "stats.h"
+
+// Множество инодов разбито на части со своими блокировками, чтобы потоки реже ждали друг друга
+#define DU_INODE_SHARDS 64
+#define DU_SHARD_MIN_CAPACITY 64
+#define DU_QUEUE_MIN_CAPACITY 64
+
+// Поля, нужные для подсчета: тип, число ссылок, блоки и сам инод
+#define DU_STAT_MASK (STATX_TYPE | STATX_NLINK | STATX_BLOCKS | STATX_INO)
+
+// Инод с несколькими жесткими ссылками и запись, которой он засчитывается
+typedef struct DuInode {
+    dev_t dev;
+    ino_t ino;
+    blkcnt_t blocks;
+    size_t owner;
+    bool used;
+} DuInode;
+
+// Часть множества: хеш-таблица с открытой адресацией и линейным пробированием
+typedef struct DuInodeShard {
+    pthread_mutex_t lock;
+    DuInode *slots;
+    size_t capacity;
+    size_t count;
+} DuInodeShard;
+
+// Поддиректория, блоки которой идут записи owner
+typedef struct DuTask {
+    char *path;
+    size_t owner;
+} DuTask;
+
+typedef struct DuShared {
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    DuTask *tasks;           // Стек: обход в глубину держит очередь короткой
+    size_t task_count;
+    size_t task_capacity;
+    size_t active;           // Потоки, обрабатывающие директорию
+    bool failed;
+
+    unsigned long long *blocks;  // Блоки по записям, складываются атомарно
+    size_t *rank;                // Место записи в порядке имен: инод достается меньшему
+    DuInodeShard shards[DU_INODE_SHARDS];
+} DuShared;
+
+
+static uint64_t HashInode(dev_t dev, ino_t ino) {
+    uint64_t hash = (uint64_t)ino * 0x9e3779b97f4a7c15ULL ^ (uint64_t)dev * 0xc2b2ae3d27d4eb4fULL;
+    return hash ^ (hash >> 29);
+}
+
+
+static DuInode *FindInodeSlot(DuInode *slots, size_t capacity, uint64_t hash, dev_t dev, ino_t ino) {
+    size_t idx = (size_t)hash & (capacity - 1);
+    while (slots[idx].used && (slots[idx].dev != dev || slots[idx].ino != ino)) {
+        idx = (idx + 1) & (capacity - 1);
+    }
+    return &slots[idx];
+}
+
+
+// Увеличение части вдвое при заполнении более чем на 3/4
+static bool GrowShard(DuInodeShard *shard) {
+    size_t new_capacity = shard->capacity ? shard->capacity * 2 : DU_SHARD_MIN_CAPACITY;
+    DuInode *new_slots = calloc(new_capacity, sizeof(DuInode));
+    if (!new_slots) return false;
+
+    for (size_t i = 0; i < shard->capacity; i++) {
+        const DuInode *slot = &shard->slots[i];
+        if (slot->used) {
+            *FindInodeSlot(new_slots, new_capacity, HashInode(slot->dev, slot->ino), slot->dev, slot->ino) = *slot;
+        }
+    }
+    free(shard->slots);
+    shard->slots = new_slots;
+    shard->capacity = new_capacity;
+    return true;
+}
+
+
+// Инод засчитывается первой по имени записи, какой бы поток ни нашел его первым
+static bool CreditInode(DuShared *shared, const struct stat *statbuf, size_t owner) {
+    uint64_t hash = HashInode(statbuf->st_dev, statbuf->st_ino);
+    DuInodeShard *shard = &shared->shards[(hash >> 58) % DU_INODE_SHARDS];
+    bool ok = true;
+    pthread_mutex_lock(&shard->lock);
+    DuInode *slot = shard->capacity ? FindInodeSlot(shard->slots, shard->capacity, hash, statbuf->st_dev, statbuf->st_ino) : NULL;
+    if (slot && slot->used) {
+        if (shared->rank[owner] < shared->rank[slot->owner]) slot->owner = owner;
+    } else if ((shard->count + 1) * 4 > shard->capacity * 3 && !GrowShard(shard)) {
+        ok = false;
+    } else {
+        slot = FindInodeSlot(shard->slots, shard->capacity, hash, statbuf->st_dev, statbuf->st_ino);
+        slot->dev = statbuf->st_dev;
+        slot->ino = statbuf->st_ino;
+        slot->blocks = statbuf->st_blocks;
+        slot->owner = owner;
+        slot->used = true;
+        shard->count++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return ok;
+}
+
+
+// Добавление найденных поддиректорий в общий стек одной блокировкой
+static bool PushTasks(DuShared *shared, DuTask *tasks, size_t count) {
+    if (count == 0) return true;
+    pthread_mutex_lock(&shared->lock);
+    if (shared->task_count + count > shared->task_capacity) {
+        size_t new_capacity = shared->task_capacity ? shared->task_capacity : DU_QUEUE_MIN_CAPACITY;
+        while (new_capacity < shared->task_count + count) new_capacity *= 2;
+        DuTask *new_tasks = realloc(shared->tasks, new_capacity * sizeof(DuTask));
+        if (!new_tasks) {
+            pthread_mutex_unlock(&shared->lock);
+            return false;
+        }
+        shared->tasks = new_tasks;
+        shared->task_capacity = new_capacity;
+    }
+    memcpy(shared->tasks + shared->task_count, tasks, count * sizeof(DuTask));
+    shared->task_count += count;
+    pthread_cond_broadcast(&shared->work_ready);
+    pthread_mutex_unlock(&shared->lock);
+    return true;
+}
+
+
+static char *JoinDuPath(const char *dir, const char *name, size_t name_len) {
+    size_t dir_len = strlen(dir);
+    char *path = malloc(dir_len + name_len + 2);
+    if (!path) return NULL;
+    memcpy(path, dir, dir_len);
+    path[dir_len] = '/';
+    memcpy(path + dir_len + 1, name, name_len + 1);
+    return path;
+}
+
+
+// Блоки всех записей одной директории; поддиректории уходят в общий стек
+static bool ScanDirectory(DuShared *shared, const DuTask *task) {
+    DirReader reader;
+    CountStats(STATS_DIRS, 1);
+    if (!OpenDirReader(&reader, task->path)) {
+        fprintf(stderr, "Could not open directory: %s\n", task->path);
+        return true;
+    }
+
+    unsigned long long blocks = 0;
+    size_t entries = 0;
+    DuTask *subdirs = NULL;
+    size_t subdir_count = 0;
+    size_t subdir_capacity = 0;
+    bool ok = true;
+    RawDirEntry entry;
+    int status;
+    while (ok && (status = ReadDirEntry(&reader, &entry)) > 0) {
+        if (strcmp(entry.name, ".") == 0 || strcmp(entry.name, "..") == 0) continue;
+        entries++;
+        struct stat statbuf;
+        if (StatAt(reader.fd, entry.name, false, DU_STAT_MASK, &statbuf) != 0) {
+            fprintf(stderr, "Error retrieving info for %s/%s\n", task->path, entry.name);
+            continue;
+        }
+        if (S_ISDIR(statbuf.st_mode)) {
+            blocks += (unsigned long long)statbuf.st_blocks;
+            if (subdir_count == subdir_capacity) {
+                subdir_capacity = subdir_capacity ? subdir_capacity * 2 : 16;
+                DuTask *new_subdirs = realloc(subdirs, subdir_capacity * sizeof(DuTask));
+                if (!new_subdirs) {
+                    ok = false;
+                    break;
+                }
+                subdirs = new_subdirs;
+            }
+            char *path = JoinDuPath(task->path, entry.name, entry.name_len);
+            if (!path) {
+                ok = false;
+                break;
+            }
+            subdirs[subdir_count].path = path;
+            subdirs[subdir_count++].owner = task->owner;
+        } else if (statbuf.st_nlink > 1) {
+            ok = CreditInode(shared, &statbuf, task->owner);
+        } else {
+            blocks += (unsigned long long)statbuf.st_blocks;
+        }
+    }
+    if (ok && status < 0) {
+        fprintf(stderr, "Could not read directory: %s\n", task->path);
+    }
+    CloseDirReader(&reader);
+    CountStats(STATS_ENTRIES, entries);
+    CountStats(STATS_STAT_CALLS, entries);
+    __atomic_add_fetch(&shared->blocks[task->owner], blocks, __ATOMIC_RELAXED);
+
+    if (ok) ok = PushTasks(shared, subdirs, subdir_count);
+    if (!ok) {
+        for (size_t i = 0; i < subdir_count; i++) {
+            free(subdirs[i].path);
+        }
+    }
+    free(subdirs);
+    return ok;
+}
+
+
+// Потоки берут директории из общего стека, пока он не опустеет и все не закончат работу
+static void *DuWorker(void *arg) {
+    DuShared *shared = arg;
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_STAT);
+    pthread_mutex_lock(&shared->lock);
+    for (;;) {
+        while (shared->task_count == 0 && shared->active > 0 && !shared->failed) {
+            pthread_cond_wait(&shared->work_ready, &shared->lock);
+        }
+        if (shared->task_count == 0 || shared->failed) break;
+        DuTask task = shared->tasks[--shared->task_count];
+        shared->active++;
+        pthread_mutex_unlock(&shared->lock);
+
+        bool ok = ScanDirectory(shared, &task);
+        free(task.path);
+
+        pthread_mutex_lock(&shared->lock);
+        shared->active--;
+        if (!ok) shared->failed = true;
+        if (shared->active == 0 || !ok) pthread_cond_broadcast(&shared->work_ready);
+    }
+    pthread_mutex_unlock(&shared->lock);
+    LeaveStatsPhase(previous);
+    return NULL;
+}
+
+
+static void FreeDuShared(DuShared *shared) {
+    for (size_t i = 0; i < shared->task_count; i++) {
+        free(shared->tasks[i].path);
+    }
+    free(shared->tasks);
+    for (int i = 0; i < DU_INODE_SHARDS; i++) {
+        free(shared->shards[i].slots);
+        pthread_mutex_destroy(&shared->shards[i].lock);
+    }
+    pthread_cond_destroy(&shared->work_ready);
+    pthread_mutex_destroy(&shared->lock);
+    free(shared->blocks);
+    free(shared->rank);
+}
+
+
+// Места записей в порядке имен, как у du -s *; не зависит от порядка директории и опций сортировки
+static bool RankEntries(const FileEntry *entries, size_t count, size_t *rank) {
+    ListArgs by_name = {.sort = SORT_NAME};
+    const FileEntry **order = SortEntries(entries, count, &by_name);
+    if (!order) return false;
+    for (size_t i = 0; i < count; i++) {
+        rank[order[i] - entries] = i;
+    }
+    free(order);
+    return true;
+}
+
+
+// Общая часть AggregateDiskUsage и AggregatePathsDiskUsage: без path имена записей - полные пути
+static bool Aggregate(const char *path, FileEntry *entries, size_t count, int jobs) {
+    DuShared shared;
+    memset(&shared, 0, sizeof(shared));
+    pthread_mutex_init(&shared.lock, NULL);
+    pthread_cond_init(&shared.work_ready, NULL);
+    for (int i = 0; i < DU_INODE_SHARDS; i++) {
+        pthread_mutex_init(&shared.shards[i].lock, NULL);
+    }
+    shared.blocks = calloc(count ? count : 1, sizeof(unsigned long long));
+    shared.rank = malloc((count ? count : 1) * sizeof(size_t));
+    bool ok = shared.blocks && shared.rank && RankEntries(entries, count, shared.rank);
+
+    // Записи самой директории: поддиректории становятся задачами, жесткие ссылки - кандидатами
+    for (size_t i = 0; ok && i < count; i++) {
+        FileEntry *entry = &entries[i];
+        const struct stat *statbuf = &entry->statbuf;
+        bool self = path && (strcmp(entry->name, ".") == 0 || strcmp(entry->name, "..") == 0);
+        if (S_ISDIR(statbuf->st_mode) && entry->type != DT_LNK && !self) {
+            shared.blocks[i] = (unsigned long long)statbuf->st_blocks;
+            DuTask task = {path ? JoinDuPath(path, entry->name, entry->name_len) : strdup(entry->name), i};
+            ok = task.path && PushTasks(&shared, &task, 1);
+            if (!ok) free(task.path);
+        } else if (!S_ISDIR(statbuf->st_mode) && statbuf->st_nlink > 1) {
+            ok = CreditInode(&shared, statbuf, i);
+        } else {
+            shared.blocks[i] = (unsigned long long)statbuf->st_blocks;
+        }
+    }
+
+    // Вызывающий поток работает наравне с остальными
+    int thread_count = 0;
+    pthread_t *threads = (ok && jobs > 1) ? malloc((size_t)(jobs - 1) * sizeof(pthread_t)) : NULL;
+    for (int i = 0; threads && i < jobs - 1; i++) {
+        if (pthread_create(&threads[i], NULL, DuWorker, &shared) != 0) break;
+        thread_count++;
+    }
+    if (ok) DuWorker(&shared);
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    ok = ok && !shared.failed;
+
+    if (ok) {
+        for (int s = 0; s < DU_INODE_SHARDS; s++) {
+            const DuInodeShard *shard = &shared.shards[s];
+            for (size_t i = 0; i < shard->capacity; i++) {
+                if (shard->slots[i].used) shared.blocks[shard->slots[i].owner] += (unsigned long long)shard->slots[i].blocks;
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            entries[i].statbuf.st_blocks = (blkcnt_t)shared.blocks[i];
+        }
+    } else {
+        fprintf(stderr, "Memory allocation failed\n");
+    }
+    FreeDuShared(&shared);
+    return ok;
+}
+
+bool AggregateDiskUsage(const char *path, FileEntry *entries, size_t count, int jobs) {
+    return Aggregate(path, entries, count, jobs);
+}
+
+bool AggregatePathsDiskUsage(FileEntry *entries, size_t count, int jobs) {
+    return Aggregate(NULL, entries, count, jobs);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "entry_store.h"
+
+// Disk usage of directory entries (--du): st_blocks of every subdirectory entry of path
+// becomes the allocated blocks of its whole subtree, itself included
+// Every inode is counted once: a file with several hard links is credited to the first
+// entry by name that reaches it, the others do not count it (so the blocks of
+// a top-level hard link may become 0). Symbolic links are not followed, "." and ".."
+// keep their own blocks. Entries must carry full stat data
+// Subtrees are scanned by jobs threads sharing one queue of directories; unreadable
+// directories are reported on stderr and skipped
+// Returns false with a message on stderr if memory allocation failed
+bool AggregateDiskUsage(const char *path, FileEntry *entries, size_t count, int jobs);
+// Same for the argument paths themselves (--du with -s or -d): entries name directories
+// by their full path, as StatPathEntry leaves them, and get the blocks of their subtrees
+bool AggregatePathsDiskUsage(FileEntry *entries, size_t count, int jobs);
@@ -0,0 +1,108 @@
+#include "entry_store.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+#define ENTRY_STORE_MIN_CAPACITY 64
+#define NAME_BLOCK_SIZE (64 * 1024)
+
+struct NameBlock {
+    NameBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
+};
+
+void InitEntryStore(EntryStore *store) {
+    store->entries = NULL;
+    store->count = 0;
+    store->capacity = 0;
+    store->blocks = NULL;
+    store->arena_bytes = 0;
+}
+
+void FreeEntryStore(EntryStore *store) {
+    AddStoreBytes(-(long long)(store->capacity * sizeof(FileEntry) + store->arena_bytes));
+    NameBlock *block = store->blocks;
+    while (block) {
+        NameBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(store->entries);
+    InitEntryStore(store);
+}
+
+void ResetEntryStore(EntryStore *store) {
+    NameBlock *block = store->blocks;
+    if (block) {
+        // Самый новый блок остается, более старые освобождаются
+        NameBlock *old = block->next;
+        while (old) {
+            NameBlock *next = old->next;
+            store->arena_bytes -= old->size;
+            AddStoreBytes(-(long long)old->size);
+            free(old);
+            old = next;
+        }
+        block->next = NULL;
+        block->used = 0;
+    }
+    store->count = 0;
+}
+
+// Выделение места под строку в текущем блоке арены либо в новом блоке
+char *AllocName(EntryStore *store, size_t name_len) {
+    NameBlock *block = store->blocks;
+    if (!block || block->size - block->used < name_len + 1) {
+        // Длинные строки получают собственный блок, чтобы не тратить остаток текущего
+        size_t size = (name_len + 1 > NAME_BLOCK_SIZE) ? name_len + 1 : NAME_BLOCK_SIZE;
+        NameBlock *new_block = malloc(sizeof(NameBlock) + size);
+        if (!new_block) return NULL;
+        new_block->used = 0;
+        new_block->size = size;
+        new_block->next = block;
+        store->blocks = new_block;
+        store->arena_bytes += size;
+        AddStoreBytes((long long)size);
+        block = new_block;
+    }
+
+    char *dst = block->data + block->used;
+    block->used += name_len + 1;
+    return dst;
+}
+
+char *StoreName(EntryStore *store, const char *name, size_t name_len) {
+    char *dst = AllocName(store, name_len);
+    if (!dst) return NULL;
+    memcpy(dst, name, name_len);
+    dst[name_len] = '\0';
+    return dst;
+}
+
+FileEntry *AddEntry(EntryStore *store, const char *name, size_t name_len, const struct stat *statbuf) {
+    if (store->count == store->capacity) {
+        // Геометрический рост: амортизированно O(1) на запись
+        size_t new_capacity = store->capacity ? store->capacity * 2 : ENTRY_STORE_MIN_CAPACITY;
+        FileEntry *new_entries = realloc(store->entries, new_capacity * sizeof(FileEntry));
+        if (!new_entries) return NULL;
+        AddStoreBytes((long long)((new_capacity - store->capacity) * sizeof(FileEntry)));
+        store->entries = new_entries;
+        store->capacity = new_capacity;
+    }
+
+    const char *stored_name = StoreName(store, name, name_len);
+    if (!stored_name) return NULL;
+
+    FileEntry *entry = &store->entries[store->count++];
+    entry->name = stored_name;
+    entry->name_len = (unsigned int)name_len;
+    entry->type = 0;
+    entry->target = NULL;
+    entry->target_len = 0;
+    entry->statbuf = *statbuf;
+    return entry;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <sys/stat.h>
+
+// Compact per-entry record; the name and the link target live in the store's name arena
+typedef struct FileEntry {
+    const char *name;
+    unsigned int name_len;
+    unsigned char type;  // DT_* value reported by readdir
+    unsigned int target_len;
+    const char *target;  // Symbolic link target if it was requested and read, otherwise NULL
+    struct stat statbuf;
+} FileEntry;
+
+typedef struct NameBlock NameBlock;
+
+// Entries of a single directory: geometrically growing record array
+// plus a chunked arena holding variable-length names
+typedef struct EntryStore {
+    FileEntry *entries;
+    size_t count;
+    size_t capacity;
+    NameBlock *blocks;
+    size_t arena_bytes;
+} EntryStore;
+
+// Initialize an empty store (no allocations are made)
+void InitEntryStore(EntryStore *store);
+// Free all records and names at once; the store becomes empty again
+void FreeEntryStore(EntryStore *store);
+
+// Drop all records and names but keep the record array and one arena block for reuse
+void ResetEntryStore(EntryStore *store);
+
+// Copy the name into the arena and append a record with the given stat
+// Returns the new record or NULL if memory allocation failed
+FileEntry *AddEntry(EntryStore *store, const char *name, size_t name_len, const struct stat *statbuf);
+// Copy a string of the given length into the arena (NUL-terminated)
+// Returns NULL if memory allocation failed
+char *StoreName(EntryStore *store, const char *name, size_t name_len);
+// Reserve name_len + 1 bytes in the arena to be filled in place (e.g. by readlinkat)
+// Returns NULL if memory allocation failed
+char *AllocName(EntryStore *store, size_t name_len);
@@ -0,0 +1,180 @@
+#include "glob.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    GLOB_LITERAL,
+    GLOB_ANY,
+    GLOB_CLASS,
+    GLOB_STAR,
+};
+
+struct GlobToken {
+    unsigned char type;
+    unsigned char ch;    // GLOB_LITERAL
+    uint32_t set[8];     // GLOB_CLASS: битовое множество байтов (уже с учетом отрицания)
+};
+
+static void SetBit(uint32_t *set, unsigned char c) {
+    set[c >> 5] |= 1u << (c & 31);
+}
+
+static bool TestBit(const uint32_t *set, unsigned char c) {
+    return (set[c >> 5] >> (c & 31)) & 1u;
+}
+
+// Разбор класса начиная с символа после '['
+// Возвращает позицию после ']' или NULL, если класс не закрыт
+static const char *ParseClass(const char *p, uint32_t *set) {
+    bool negate = false;
+    if (*p == '!' || *p == '^') {
+        negate = true;
+        p++;
+    }
+    memset(set, 0, 8 * sizeof(uint32_t));
+
+    // ']' сразу после открывающей скобки - обычный символ
+    bool first = true;
+    while (*p != '\0' && (*p != ']' || first)) {
+        first = false;
+        unsigned char lo = (unsigned char)*p;
+        if (lo == '\\' && p[1] != '\0') {
+            lo = (unsigned char)*++p;
+        }
+        p++;
+
+        unsigned char hi = lo;
+        if (*p == '-' && p[1] != '\0' && p[1] != ']') {
+            p++;
+            hi = (unsigned char)*p;
+            if (hi == '\\' && p[1] != '\0') {
+                hi = (unsigned char)*++p;
+            }
+            p++;
+        }
+        // Диапазон с обратными границами пуст, как в fnmatch
+        for (unsigned int c = lo; c <= hi; c++) {
+            SetBit(set, (unsigned char)c);
+        }
+    }
+    if (*p != ']') {
+        return NULL;
+    }
+
+    if (negate) {
+        for (int i = 0; i < 8; i++) {
+            set[i] = ~set[i];
+        }
+    }
+    return p + 1;
+}
+
+bool CompileGlob(GlobPattern *glob, const char *pattern) {
+    glob->count = 0;
+    glob->min_len = 0;
+    // Токенов не больше, чем символов шаблона
+    glob->tokens = malloc((strlen(pattern) + 1) * sizeof(GlobToken));
+    if (!glob->tokens) {
+        return false;
+    }
+
+    const char *p = pattern;
+    while (*p != '\0') {
+        GlobToken *token = &glob->tokens[glob->count];
+        if (*p == '*') {
+            // Подряд идущие звездочки эквивалентны одной
+            while (*p == '*') p++;
+            token->type = GLOB_STAR;
+            glob->count++;
+            continue;
+        }
+
+        if (*p == '?') {
+            token->type = GLOB_ANY;
+            p++;
+        } else if (*p == '[') {
+            const char *end = ParseClass(p + 1, token->set);
+            if (end) {
+                token->type = GLOB_CLASS;
+                p = end;
+            } else {
+                token->type = GLOB_LITERAL;
+                token->ch = '[';
+                p++;
+            }
+        } else {
+            if (*p == '\\' && p[1] != '\0') {
+                p++;
+            }
+            token->type = GLOB_LITERAL;
+            token->ch = (unsigned char)*p;
+            p++;
+        }
+        glob->count++;
+        glob->min_len++;
+    }
+    return true;
+}
+
+void FreeGlob(GlobPattern *glob) {
+    free(glob->tokens);
+    glob->tokens = NULL;
+    glob->count = 0;
+}
+
+static bool TokenMatches(const GlobToken *token, unsigned char c) {
+    switch (token->type) {
+        case GLOB_LITERAL:
+            return token->ch == c;
+        case GLOB_ANY:
+            return true;
+        default:
+            return TestBit(token->set, c);
+    }
+}
+
+// Жадное сопоставление двумя указателями: при неудаче возвращаемся только
+// к последней звездочке, более ранние звездочки пересматривать не нужно
+bool MatchGlob(const GlobPattern *glob, const char *name, size_t len) {
+    if (len < glob->min_len) {
+        return false;
+    }
+
+    const GlobToken *tokens = glob->tokens;
+    size_t count = glob->count;
+    size_t ti = 0, si = 0;
+    size_t star_ti = SIZE_MAX, star_si = 0;
+
+    while (si < len) {
+        if (ti < count && tokens[ti].type == GLOB_STAR) {
+            star_ti = ti++;
+            star_si = si;
+        } else if (ti < count && TokenMatches(&tokens[ti], (unsigned char)name[si])) {
+            ti++;
+            si++;
+        } else if (star_ti != SIZE_MAX) {
+            ti = star_ti + 1;
+            si = ++star_si;
+        } else {
+            return false;
+        }
+    }
+
+    while (ti < count && tokens[ti].type == GLOB_STAR) {
+        ti++;
+    }
+    return ti == count;
+}
+
+bool HasGlobMeta(const char *pattern) {
+    for (const char *p = pattern; *p != '\0'; p++) {
+        if (*p == '\\' && p[1] != '\0') {
+            p++;
+        } else if (*p == '*' || *p == '?' || *p == '[') {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct GlobToken GlobToken;
+
+// Pattern compiled once and matched against many names
+// Supports `*`, `?`, `[...]` classes with ranges and `!`/`^` negation, and `\` escapes
+typedef struct GlobPattern {
+    GlobToken *tokens;
+    size_t count;
+    size_t min_len;  // Names shorter than this never match
+} GlobPattern;
+
+// Compile the pattern; returns false if memory allocation failed
+// An unterminated `[` is taken literally
+bool CompileGlob(GlobPattern *glob, const char *pattern);
+// Free the compiled pattern
+void FreeGlob(GlobPattern *glob);
+
+// Match a whole name of the given length in O(len * tokens) time without recursion
+bool MatchGlob(const GlobPattern *glob, const char *name, size_t len);
+
+// Check whether the pattern has an unescaped `*`, `?` or `[`
+bool HasGlobMeta(const char *pattern);
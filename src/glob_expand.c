@@ -0,0 +1,420 @@
+#include "glob_expand.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "dirscan.h"
+#include "glob.h"
+
+#define NODE_TABLE_MIN_SIZE 64
+
+// Разобранный шаблон: компоненты пути и найденные совпадения
+typedef struct ExpandPattern {
+    char **comps;          // Литеральные компоненты хранятся уже без экранирования
+    GlobPattern *globs;
+    bool *meta;            // Компонент содержит шаблон
+    bool *dot;             // Компонент явно начинается с '.'
+    size_t comp_count;
+    bool dir_only;         // Шаблон оканчивается на '/'
+    GenericVector *results;
+    char **matches;        // Строки выделены в арене results
+    size_t match_count;
+    size_t match_capacity;
+} ExpandPattern;
+
+// Шаблон, ожидающий чтения директории: номер шаблона и его компонента
+typedef struct DirMatcher {
+    size_t pattern;
+    size_t comp;
+} DirMatcher;
+
+// Директория, которую нужно прочитать, со всеми ожидающими ее шаблонами
+typedef struct DirNode {
+    char *path;            // "" - текущая директория
+    DirMatcher *matchers;
+    size_t count;
+    size_t capacity;
+} DirNode;
+
+// Директории одной глубины
+typedef struct DirLevel {
+    DirNode **nodes;
+    size_t count;
+    size_t capacity;
+} DirLevel;
+
+typedef struct ExpandState {
+    ExpandPattern *patterns;
+    size_t pattern_count;
+    // Открытая адресация по пути: каждая директория попадает в очередь один раз
+    DirNode **table;
+    size_t table_size;
+    size_t table_count;
+    DirLevel *levels;
+    size_t level_count;
+    bool failed;
+} ExpandState;
+
+
+static bool Grow(void **arr, size_t *capacity, size_t count, size_t elem_size) {
+    if (count < *capacity) return true;
+    size_t new_capacity = *capacity ? *capacity * 2 : 8;
+    void *new_arr = realloc(*arr, new_capacity * elem_size);
+    if (!new_arr) return false;
+    *arr = new_arr;
+    *capacity = new_capacity;
+    return true;
+}
+
+static uint64_t HashPath(const char *path) {
+    uint64_t hash = 1469598103934665603ULL;  // FNV-1a
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// "dir/name"; пустой dir - текущая директория, "/" - корень
+static char *JoinGlobPath(const char *dir, const char *name, size_t name_len) {
+    size_t dir_len = strlen(dir);
+    char *path = malloc(dir_len + name_len + 2);
+    if (!path) return NULL;
+    memcpy(path, dir, dir_len);
+    size_t pos = dir_len;
+    if (dir_len > 0 && dir[dir_len - 1] != '/') {
+        path[pos++] = '/';
+    }
+    memcpy(path + pos, name, name_len);
+    path[pos + name_len] = '\0';
+    return path;
+}
+
+// Копия литерального компонента без обратных слешей
+static char *Unescape(const char *comp, size_t len) {
+    char *out = malloc(len + 1);
+    if (!out) return NULL;
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (comp[i] == '\\' && i + 1 < len) i++;
+        out[n++] = comp[i];
+    }
+    out[n] = '\0';
+    return out;
+}
+
+static bool ParsePattern(ExpandPattern *pt, const char *pattern) {
+    memset(pt, 0, sizeof(*pt));
+    size_t len = strlen(pattern);
+    pt->dir_only = len > 0 && pattern[len - 1] == '/';
+
+    // Непустые компоненты разделены '/', поэтому их не больше len / 2 + 1
+    size_t max_comps = len / 2 + 1;
+    pt->comps = calloc(max_comps, sizeof(char *));
+    pt->globs = calloc(max_comps, sizeof(GlobPattern));
+    pt->meta = calloc(max_comps, sizeof(bool));
+    pt->dot = calloc(max_comps, sizeof(bool));
+    if (!pt->comps || !pt->globs || !pt->meta || !pt->dot) return false;
+
+    const char *p = pattern;
+    while (*p) {
+        // Пустые компоненты ("a//b", ведущий и завершающий '/') пропускаются
+        if (*p == '/') {
+            p++;
+            continue;
+        }
+        const char *end = p;
+        while (*end && *end != '/') end++;
+        size_t comp_len = (size_t)(end - p);
+        size_t ci = pt->comp_count++;
+
+        char *raw = strndup(p, comp_len);
+        if (!raw) return false;
+        pt->meta[ci] = HasGlobMeta(raw);
+        pt->dot[ci] = raw[0] == '.' || (raw[0] == '\\' && raw[1] == '.');
+        if (pt->meta[ci]) {
+            pt->comps[ci] = raw;
+            if (!CompileGlob(&pt->globs[ci], raw)) return false;
+        } else {
+            pt->comps[ci] = Unescape(raw, comp_len);
+            free(raw);
+            if (!pt->comps[ci]) return false;
+        }
+        p = end;
+    }
+    return true;
+}
+
+static void FreePattern(ExpandPattern *pt) {
+    for (size_t i = 0; i < pt->comp_count; i++) {
+        free(pt->comps[i]);
+        if (pt->meta && pt->meta[i]) FreeGlob(&pt->globs[i]);
+    }
+    free(pt->comps);
+    free(pt->globs);
+    free(pt->meta);
+    free(pt->dot);
+    free(pt->matches);
+}
+
+static bool IsGlobStar(const ExpandPattern *pt, size_t ci) {
+    return pt->meta[ci] && strcmp(pt->comps[ci], "**") == 0;
+}
+
+
+// Совпадение найдено; verify - путь собран из литералов и может не существовать
+static void AddMatch(ExpandState *state, ExpandPattern *pt, const char *path, bool verify) {
+    struct stat st;
+    if (pt->dir_only) {
+        if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) return;
+    } else if (verify && lstat(path, &st) != 0) {
+        return;
+    }
+
+    if (!Grow((void **)&pt->matches, &pt->match_capacity, pt->match_count, sizeof(char *))) {
+        state->failed = true;
+        return;
+    }
+    // Совпадения шаблона с '/' на конце выводятся с '/', как в оболочке
+    size_t len = strlen(path);
+    bool slash = pt->dir_only && len > 0 && path[len - 1] != '/';
+    char *match = AllocString(pt->results, len + slash);
+    if (!match) {
+        state->failed = true;
+        return;
+    }
+    memcpy(match, path, len);
+    if (slash) match[len++] = '/';
+    match[len] = '\0';
+    pt->matches[pt->match_count++] = match;
+}
+
+static DirNode *FindNode(ExpandState *state, const char *path, size_t depth) {
+    if (state->table_count * 2 >= state->table_size) {
+        size_t new_size = state->table_size ? state->table_size * 2 : NODE_TABLE_MIN_SIZE;
+        DirNode **new_table = calloc(new_size, sizeof(DirNode *));
+        if (!new_table) return NULL;
+        for (size_t i = 0; i < state->table_size; i++) {
+            DirNode *node = state->table[i];
+            if (!node) continue;
+            size_t slot = HashPath(node->path) & (new_size - 1);
+            while (new_table[slot]) slot = (slot + 1) & (new_size - 1);
+            new_table[slot] = node;
+        }
+        free(state->table);
+        state->table = new_table;
+        state->table_size = new_size;
+    }
+
+    size_t slot = HashPath(path) & (state->table_size - 1);
+    while (state->table[slot]) {
+        if (strcmp(state->table[slot]->path, path) == 0) {
+            return state->table[slot];
+        }
+        slot = (slot + 1) & (state->table_size - 1);
+    }
+
+    // Новая директория встает в очередь своей глубины
+    while (state->level_count <= depth) {
+        DirLevel *levels = realloc(state->levels, (state->level_count + 1) * sizeof(DirLevel));
+        if (!levels) return NULL;
+        state->levels = levels;
+        memset(&state->levels[state->level_count++], 0, sizeof(DirLevel));
+    }
+    DirLevel *level = &state->levels[depth];
+    if (!Grow((void **)&level->nodes, &level->capacity, level->count, sizeof(DirNode *))) return NULL;
+
+    DirNode *node = calloc(1, sizeof(DirNode));
+    if (!node) return NULL;
+    node->path = strdup(path);
+    if (!node->path) {
+        free(node);
+        return NULL;
+    }
+    state->table[slot] = node;
+    state->table_count++;
+    level->nodes[level->count++] = node;
+    return node;
+}
+
+static void Enqueue(ExpandState *state, const char *path, size_t depth, size_t pattern, size_t comp) {
+    DirNode *node = FindNode(state, path, depth);
+    if (!node) {
+        state->failed = true;
+        return;
+    }
+    for (size_t i = 0; i < node->count; i++) {
+        if (node->matchers[i].pattern == pattern && node->matchers[i].comp == comp) return;
+    }
+    if (!Grow((void **)&node->matchers, &node->capacity, node->count, sizeof(DirMatcher))) {
+        state->failed = true;
+        return;
+    }
+    node->matchers[node->count++] = (DirMatcher){pattern, comp};
+}
+
+// Продвижение шаблона pattern, у которого совпали компоненты до comp, до пути path
+// Литеральные компоненты присоединяются сразу, для шаблонных директория ставится в очередь
+static void Visit(ExpandState *state, const char *path, size_t depth, size_t pattern, size_t comp, bool verify) {
+    ExpandPattern *pt = &state->patterns[pattern];
+    if (state->failed) return;
+    if (comp == pt->comp_count) {
+        AddMatch(state, pt, path, verify);
+        return;
+    }
+
+    if (!pt->meta[comp]) {
+        char *child = JoinGlobPath(path, pt->comps[comp], strlen(pt->comps[comp]));
+        if (!child) {
+            state->failed = true;
+            return;
+        }
+        Visit(state, child, depth + 1, pattern, comp + 1, true);
+        free(child);
+        return;
+    }
+
+    // `**` может не совпасть ни с одной директорией; в конце шаблона
+    // это дает саму директорию с '/', как в bash
+    if (IsGlobStar(pt, comp) && comp + 1 < pt->comp_count) {
+        Visit(state, path, depth, pattern, comp + 1, verify);
+    } else if (IsGlobStar(pt, comp) && path[0] != '\0' && strcmp(path, "/") != 0) {
+        char *self = JoinGlobPath(path, "", 0);
+        if (!self) {
+            state->failed = true;
+            return;
+        }
+        AddMatch(state, pt, self, verify);
+        free(self);
+    }
+    Enqueue(state, path, depth, pattern, comp);
+}
+
+// Является ли запись директорией (без перехода по ссылкам)
+static bool IsRealDir(int dirfd, const RawDirEntry *entry) {
+    if (entry->type != DT_UNKNOWN) return entry->type == DT_DIR;
+    struct stat st;
+    return fstatat(dirfd, entry->name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+}
+
+// Однократное чтение директории со сравнением каждой записи со всеми ожидающими шаблонами
+static void ScanNode(ExpandState *state, const DirNode *node, size_t depth) {
+    DirReader reader;
+    // Несуществующие пути и не-директории просто не дают совпадений
+    if (!OpenDirReader(&reader, node->path[0] ? node->path : ".")) return;
+
+    RawDirEntry entry;
+    while (!state->failed && ReadDirEntry(&reader, &entry) > 0) {
+        if (entry.name[0] == '.' && (entry.name_len == 1 || (entry.name_len == 2 && entry.name[1] == '.'))) {
+            continue;
+        }
+        bool hidden = entry.name[0] == '.';
+        char *child = NULL;
+        int is_dir = -1;
+
+        for (size_t i = 0; i < node->count && !state->failed; i++) {
+            ExpandPattern *pt = &state->patterns[node->matchers[i].pattern];
+            size_t comp = node->matchers[i].comp;
+            bool last = comp + 1 == pt->comp_count;
+            bool globstar = IsGlobStar(pt, comp);
+
+            if (hidden && (globstar || !pt->dot[comp])) continue;
+            if (!globstar && !MatchGlob(&pt->globs[comp], entry.name, entry.name_len)) continue;
+            // Не последний компонент может совпасть только с директорией или ссылкой на нее
+            if (!last && !globstar && entry.type != DT_DIR && entry.type != DT_LNK && entry.type != DT_UNKNOWN) continue;
+
+            if (!child) {
+                child = JoinGlobPath(node->path, entry.name, entry.name_len);
+                if (!child) {
+                    state->failed = true;
+                    break;
+                }
+            }
+            if (globstar) {
+                if (last) {
+                    AddMatch(state, pt, child, false);
+                }
+                if (is_dir < 0) is_dir = IsRealDir(reader.fd, &entry);
+                if (is_dir) {
+                    // Тот же `**` продолжается в поддиректории (без повторного вывода ее с '/')
+                    if (!last) {
+                        Visit(state, child, depth + 1, node->matchers[i].pattern, comp + 1, false);
+                    }
+                    Enqueue(state, child, depth + 1, node->matchers[i].pattern, comp);
+                }
+            } else {
+                Visit(state, child, depth + 1, node->matchers[i].pattern, comp + 1, false);
+            }
+        }
+        free(child);
+    }
+    CloseDirReader(&reader);
+}
+
+static int CompareMatches(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+bool ExpandGlobPatterns(const char *const *patterns, size_t count, GenericVector **results) {
+    ExpandState state;
+    memset(&state, 0, sizeof(state));
+    state.patterns = calloc(count ? count : 1, sizeof(ExpandPattern));
+    if (!state.patterns) return false;
+    state.pattern_count = count;
+
+    for (size_t i = 0; i < count && !state.failed; i++) {
+        if (!ParsePattern(&state.patterns[i], patterns[i])) {
+            state.failed = true;
+            break;
+        }
+        state.patterns[i].results = results[i];
+        Visit(&state, patterns[i][0] == '/' ? "/" : "", 0, i, 0, false);
+    }
+
+    // Директория глубины d появляется только при обработке меньших глубин,
+    // поэтому к моменту чтения все ее шаблоны уже собраны
+    for (size_t depth = 0; depth < state.level_count && !state.failed; depth++) {
+        for (size_t i = 0; i < state.levels[depth].count && !state.failed; i++) {
+            ScanNode(&state, state.levels[depth].nodes[i], depth);
+        }
+    }
+
+    for (size_t i = 0; i < count && !state.failed; i++) {
+        ExpandPattern *pt = &state.patterns[i];
+        if (pt->match_count > 1) {
+            qsort(pt->matches, pt->match_count, sizeof(char *), CompareMatches);
+        }
+        const char *prev = NULL;
+        for (size_t j = 0; j < pt->match_count; j++) {
+            // Повторы (например, от "**/**") остаются в арене results[i] до ее освобождения
+            if (prev && strcmp(pt->matches[j], prev) == 0) continue;
+            prev = pt->matches[j];
+            if (!Append(results[i], pt->matches[j])) {
+                state.failed = true;
+                break;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < state.table_size; i++) {
+        DirNode *node = state.table[i];
+        if (!node) continue;
+        free(node->path);
+        free(node->matchers);
+        free(node);
+    }
+    for (size_t i = 0; i < state.level_count; i++) {
+        free(state.levels[i].nodes);
+    }
+    for (size_t i = 0; i < count; i++) {
+        FreePattern(&state.patterns[i]);
+    }
+    free(state.table);
+    free(state.levels);
+    free(state.patterns);
+    return !state.failed;
+}
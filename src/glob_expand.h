@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "vector.h"
+
+// Expand path patterns with wildcards in any component
+// `**` as a whole component matches zero or more directories (symlinks are not followed)
+// Wildcards do not match a leading '.', and "." and ".." are never matched
+// A trailing '/' restricts matches to directories
+//
+// All patterns are expanded together: directories are visited in order of depth and
+// each one is read once and tested against every pattern that needs it
+// results[i] must be arena vectors (NewArenaVector): they receive the sorted unique
+// matches of patterns[i], strings allocated in their arenas
+// Returns false if memory allocation failed
+bool ExpandGlobPatterns(const char *const *patterns, size_t count, GenericVector **results);
@@ -0,0 +1,136 @@
+#include "idcache.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pwd.h>
+#include <grp.h>
+#include <pthread.h>
+
+#include "stats.h"
+
+#define ID_TABLE_MIN_CAPACITY 64
+
+typedef struct IdSlot {
+    unsigned int id;
+    bool used;
+    char *name;  // NULL - id неизвестен (отрицательный кэш)
+} IdSlot;
+
+// Хеш-таблица с открытой адресацией и линейным пробированием
+typedef struct IdTable {
+    IdSlot *slots;
+    size_t capacity;
+    size_t count;
+    IdCacheStats stats;
+} IdTable;
+
+static IdTable users;
+static IdTable groups;
+// Поиск может идти из потоков рекурсивного обхода; getpwuid/getgrgid тоже не потокобезопасны
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t HashId(unsigned int id, size_t capacity) {
+    return (size_t)(id * 2654435761u) & (capacity - 1);
+}
+
+static IdSlot *FindSlot(IdSlot *slots, size_t capacity, unsigned int id) {
+    size_t idx = HashId(id, capacity);
+    while (slots[idx].used && slots[idx].id != id) {
+        idx = (idx + 1) & (capacity - 1);
+    }
+    return &slots[idx];
+}
+
+// Увеличение таблицы вдвое при заполнении более чем на 3/4
+static bool GrowTable(IdTable *table) {
+    size_t new_capacity = table->capacity ? table->capacity * 2 : ID_TABLE_MIN_CAPACITY;
+    IdSlot *new_slots = calloc(new_capacity, sizeof(IdSlot));
+    if (!new_slots) return false;
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->slots[i].used) {
+            *FindSlot(new_slots, new_capacity, table->slots[i].id) = table->slots[i];
+        }
+    }
+    free(table->slots);
+    table->slots = new_slots;
+    table->capacity = new_capacity;
+    return true;
+}
+
+static const char *Lookup(IdTable *table, unsigned int id, bool is_group) {
+    if (table->capacity) {
+        IdSlot *slot = FindSlot(table->slots, table->capacity, id);
+        if (slot->used) {
+            table->stats.hits++;
+            return slot->name ? slot->name : "?";
+        }
+    }
+
+    table->stats.misses++;
+    if ((table->count + 1) * 4 > table->capacity * 3 && !GrowTable(table)) {
+        return NULL;
+    }
+
+    // getpwuid/getgrgid возвращают статический буфер, имя копируется в кэш
+    const char *name = NULL;
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_NSS);
+    CountStats(STATS_NSS_LOOKUPS, 1);
+    if (is_group) {
+        struct group *grp = getgrgid((gid_t)id);
+        name = grp ? grp->gr_name : NULL;
+    } else {
+        struct passwd *pwd = getpwuid((uid_t)id);
+        name = pwd ? pwd->pw_name : NULL;
+    }
+    LeaveStatsPhase(previous);
+
+    char *copy = NULL;
+    if (name && !(copy = strdup(name))) {
+        return NULL;
+    }
+
+    IdSlot *slot = FindSlot(table->slots, table->capacity, id);
+    slot->id = id;
+    slot->used = true;
+    slot->name = copy;
+    table->count++;
+    return copy ? copy : "?";
+}
+
+const char *LookupUserName(uid_t uid) {
+    pthread_mutex_lock(&cache_lock);
+    const char *name = Lookup(&users, (unsigned int)uid, false);
+    pthread_mutex_unlock(&cache_lock);
+    return name;
+}
+
+const char *LookupGroupName(gid_t gid) {
+    pthread_mutex_lock(&cache_lock);
+    const char *name = Lookup(&groups, (unsigned int)gid, true);
+    pthread_mutex_unlock(&cache_lock);
+    return name;
+}
+
+void GetIdCacheStats(IdCacheStats *user_stats, IdCacheStats *group_stats) {
+    pthread_mutex_lock(&cache_lock);
+    *user_stats = users.stats;
+    *group_stats = groups.stats;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+static void FreeTable(IdTable *table) {
+    for (size_t i = 0; i < table->capacity; i++) {
+        free(table->slots[i].name);
+    }
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+void FreeIdCache(void) {
+    pthread_mutex_lock(&cache_lock);
+    FreeTable(&users);
+    FreeTable(&groups);
+    pthread_mutex_unlock(&cache_lock);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+
+typedef struct IdCacheStats {
+    size_t hits;
+    size_t misses;
+} IdCacheStats;
+
+// Resolve uid/gid to a name, querying NSS at most once per distinct id
+// Unknown ids are cached as well and resolve to "?"
+// The returned string stays valid until FreeIdCache; NULL means memory allocation failure
+const char *LookupUserName(uid_t uid);
+const char *LookupGroupName(gid_t gid);
+
+// Get hit/miss counters of the user and group caches
+void GetIdCacheStats(IdCacheStats *users, IdCacheStats *groups);
+// Free all cached names
+void FreeIdCache(void);
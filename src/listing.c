@@ -0,0 +1,682 @@
+#include "listing.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dirscan.h"
+#include "du.h"
+#include "snapshot.h"
+#include "sort.h"
+#include "stats.h"
+
+// Размер окна потокового режима: столько записей читается, получает stat и выдается за раз
+#define STREAM_WINDOW_SIZE 4096
+
+// Число запросов statx в полете для io_uring
+#define URING_STAT_DEPTH 256
+
+#define LINK_TARGET_MIN_CAPACITY 256
+
+void InitStatEngines(StatEngines *engines, const ListArgs *args) {
+    engines->pool = NULL;
+    engines->uring = NULL;
+    engines->uring_failed = false;
+    if (args->jobs > 1) {
+        engines->pool = NewStatPool(args->jobs);
+        if (!engines->pool) {
+            fprintf(stderr, "Failed to start %d stat threads, falling back to serial mode\n", args->jobs);
+        }
+    }
+    if (args->ioUring) {
+        // Без поддержки io_uring молча используется обычный путь
+        engines->uring = NewUringStat(URING_STAT_DEPTH);
+        if (!engines->uring && args->debug) {
+            fprintf(stderr, "io_uring statx is unavailable, using synchronous stat\n");
+        }
+    }
+}
+
+
+void FreeStatEngines(StatEngines *engines) {
+    FreeUringStat(engines->uring);
+    FreeStatPool(engines->pool);
+    engines->uring = NULL;
+    engines->pool = NULL;
+}
+
+
+// Сборка пути "dir/name" в переиспользуемом буфере без ограничения длины
+char *JoinPath(char **buf, size_t *cap, const char *dir, const char *name) {
+    size_t dir_len = strlen(dir);
+    size_t name_len = strlen(name);
+    size_t needed = dir_len + name_len + 2;
+    if (needed > *cap) {
+        char *new_buf = realloc(*buf, needed);
+        if (!new_buf) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return NULL;
+        }
+        *buf = new_buf;
+        *cap = needed;
+    }
+    memcpy(*buf, dir, dir_len);
+    (*buf)[dir_len] = '/';
+    memcpy(*buf + dir_len + 1, name, name_len + 1);
+    return *buf;
+}
+
+
+// Видна ли запись с учетом -a, -A и -B
+bool EntryVisible(const ListArgs *args, const char *name, size_t name_len) {
+    if (!args->all && name[0] == '.') return false;
+    if (args->almostAll && (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)) return false;
+    if (args->ignoreBackups && name[name_len - 1] == '~') return false;
+    return true;
+}
+
+
+// Нужны ли метаданные записей (без них известен только тип из d_type)
+static bool NeedsMetadata(const ListArgs *args, const ListVisitor *visitor) {
+    return visitor->need_stat || args->du || args->sort == SORT_SIZE || args->sort == SORT_TIME;
+}
+
+
+// Минимальный набор полей statx, нужный посетителю и сортировке
+static unsigned int StatMask(const ListArgs *args, const ListVisitor *visitor) {
+    unsigned int mask = STATX_TYPE;
+    if (visitor->need_stat) {
+        mask |= STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID | STATX_SIZE | STATX_MTIME | STATX_BLOCKS;
+    }
+    if (args->du) {
+        mask |= STATX_NLINK | STATX_BLOCKS | STATX_INO;
+    }
+    if (args->sort == SORT_SIZE) {
+        mask |= STATX_SIZE;
+    } else if (args->sort == SORT_TIME) {
+        mask |= STATX_MTIME;
+    }
+    return mask;
+}
+
+
+// Выполнение stat через io_uring, а при его отказе - синхронно
+static void RunStatEngines(StatEngines *engines, const StatJob *job) {
+    if (engines->uring && !engines->uring_failed) {
+        if (RunUringStatJob(engines->uring, job)) return;
+        // Кольцо больше не используется, но освобождается только в конце,
+        // когда незавершенные запросы гарантированно не пишут в его буферы
+        engines->uring_failed = true;
+    }
+    RunStatJob(engines->pool, job);
+}
+
+
+bool ReadLinkTarget(int dirfd, const char *name, size_t size_hint, char **buf, size_t *cap, ssize_t *len) {
+    // Буфер на байт больше ожидаемого: заполненный целиком означает, что цель могла не поместиться
+    size_t needed = size_hint + 1;
+    if (needed < LINK_TARGET_MIN_CAPACITY) needed = LINK_TARGET_MIN_CAPACITY;
+    for (;;) {
+        if (*cap < needed) {
+            char *new_buf = realloc(*buf, needed);
+            if (!new_buf) return false;
+            *buf = new_buf;
+            *cap = needed;
+        }
+        *len = readlinkat(dirfd, name, *buf, *cap);
+        CountStats(STATS_READLINKS, 1);
+        if (*len < 0 || (size_t)*len < *cap) return true;
+        needed = *cap * 2;
+    }
+}
+
+
+// Цель ссылки читается прямо в арену хранилища: st_size ссылки дает точный размер,
+// лишний байт показывает, что цель не поместилась (ссылку успели заменить или st_size
+// ненадежен, как в /proc) - тогда она дочитывается через растущий буфер
+// Ошибка readlink только сообщается (target остается NULL, запись выводится без цели),
+// false - нехватка памяти
+static bool ReadEntryTarget(int dirfd, const char *dir, const char *name, EntryStore *store, FileEntry *entry,
+                            char **buf, size_t *cap) {
+    size_t hint = (size_t)entry->statbuf.st_size;
+    char *target = AllocName(store, hint);
+    if (!target) return false;
+    ssize_t len = readlinkat(dirfd, name, target, hint + 1);
+    CountStats(STATS_READLINKS, 1);
+    if (len >= 0 && (size_t)len > hint) {
+        if (!ReadLinkTarget(dirfd, name, (size_t)len, buf, cap, &len)) return false;
+        if (len >= 0 && !(target = StoreName(store, *buf, (size_t)len))) return false;
+    } else if (len >= 0) {
+        target[len] = '\0';
+    }
+    if (len < 0) {
+        fprintf(stderr, "Could not read symbolic link %s%s%s: %s\n", dir ? dir : "", dir ? "/" : "", name,
+                strerror(errno));
+        return true;
+    }
+    entry->target = target;
+    entry->target_len = (unsigned int)len;
+    return true;
+}
+
+
+// Цели всех ссылок среди записей store директории dir
+static bool ReadEntryTargets(int dirfd, const char *dir, EntryStore *store) {
+    char *buf = NULL;
+    size_t cap = 0;
+    bool ok = true;
+    for (size_t i = 0; ok && i < store->count; i++) {
+        FileEntry *entry = &store->entries[i];
+        if (S_ISLNK(entry->statbuf.st_mode)) {
+            ok = ReadEntryTarget(dirfd, dir, entry->name, store, entry, &buf, &cap);
+        }
+    }
+    free(buf);
+    return ok;
+}
+
+
+ListErrorCode StatPathEntry(const char *path, const ListArgs *args, bool link_target, EntryStore *store, FileEntry *entry) {
+    memset(entry, 0, sizeof(*entry));
+    CountStats(STATS_STAT_CALLS, 1);
+    int rc = args->dereference ? stat(path, &entry->statbuf) : lstat(path, &entry->statbuf);
+    if (rc != 0) {
+        fprintf(stderr, "Error retrieving info for %s\n", path);
+        return LIST_ERR_STAT;
+    }
+    entry->name = path;
+    entry->name_len = (unsigned int)strlen(path);
+    entry->type = IFTODT(entry->statbuf.st_mode);
+
+    if (link_target && S_ISLNK(entry->statbuf.st_mode)) {
+        char *buf = NULL;
+        size_t cap = 0;
+        bool ok = ReadEntryTarget(AT_FDCWD, NULL, path, store, entry, &buf, &cap);
+        free(buf);
+        if (!ok) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return LIST_ERR_MEMORY;
+        }
+    }
+    return LIST_SUCCESS;
+}
+
+
+// Открытие директории для листинга; время открытия относится к чтению директорий
+static bool OpenListedDirectory(DirReader *reader, const char *path) {
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_READDIR);
+    CountStats(STATS_DIRS, 1);
+    bool opened = OpenDirReader(reader, path);
+    LeaveStatsPhase(previous);
+    return opened;
+}
+
+
+// Чтение до limit записей открытой директории в хранилище с получением метаданных
+// Для простого листинга stat не вызывается: тип берется из d_type
+// *eof становится true, когда директория прочитана до конца
+static ListErrorCode CollectEntries(DirReader *reader, const char *path, const ListArgs *args, const ListVisitor *visitor,
+                                    EntryStore *store, StatEngines *engines, size_t limit, bool *eof) {
+    // Сначала собираются только имена
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_READDIR);
+    size_t first = store->count;
+    RawDirEntry entry;
+    int status = 1;
+    while (store->count < limit && (status = ReadDirEntry(reader, &entry)) > 0) {
+        if (!EntryVisible(args, entry.name, entry.name_len)) continue;
+
+        struct stat entry_stat;
+        memset(&entry_stat, 0, sizeof(entry_stat));
+        entry_stat.st_mode = DirentTypeToMode(entry.type);
+        entry_stat.st_ino = entry.ino;
+
+        // Имя копируется в арену хранилища, путь собирается заново только при выводе
+        FileEntry *added = AddEntry(store, entry.name, entry.name_len, &entry_stat);
+        if (!added) {
+            LeaveStatsPhase(previous);
+            fprintf(stderr, "Memory allocation failed\n");
+            return LIST_ERR_MEMORY;
+        }
+        added->type = entry.type;
+    }
+    *eof = (status == 0);
+    CountStats(STATS_ENTRIES, store->count - first);
+    LeaveStatsPhase(previous);
+
+    if (status < 0) {
+        fprintf(stderr, "Could not read directory: %s\n", path);
+        return LIST_ERR_READ_DIR;
+    }
+
+    // Затем метаданные: stat нужен для всех записей либо только при DT_UNKNOWN,
+    // а с -L еще и для ссылок, чтобы битые ссылки не выводились
+    int *errors = malloc((store->count ? store->count : 1) * sizeof(int));
+    if (!errors) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
+    }
+    StatJob job = {
+        .dirfd = reader->fd,
+        .entries = store->entries,
+        .count = store->count,
+        .follow_links = args->dereference,
+        .mask = StatMask(args, visitor),
+        .all_entries = NeedsMetadata(args, visitor),
+        .errors = errors,
+    };
+    previous = EnterStatsPhase(STATS_PHASE_STAT);
+    RunStatEngines(engines, &job);
+
+    // Записи с ошибкой stat выбрасываются, сообщения выводятся в порядке чтения
+    size_t kept = 0;
+    for (size_t i = 0; i < store->count; i++) {
+        if (errors[i] != 0) {
+            fprintf(stderr, "Error retrieving info for %s/%s\n", path, store->entries[i].name);
+            continue;
+        }
+        store->entries[kept++] = store->entries[i];
+    }
+    store->count = kept;
+    free(errors);
+
+    // Цели ссылок читаются, пока директория открыта
+    bool ok = !visitor->link_targets || ReadEntryTargets(reader->fd, path, store);
+    LeaveStatsPhase(previous);
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
+    }
+    // С --du блоки поддиректорий заменяются размером поддеревьев до сортировки и вывода
+    if (args->du && !AggregateDiskUsage(path, store->entries + first, store->count - first, args->jobs)) {
+        return LIST_ERR_MEMORY;
+    }
+    return LIST_SUCCESS;
+}
+
+
+// Поддиректории для рекурсивного обхода в порядке вывода; ссылки не раскрываются даже с -L
+static ListErrorCode CollectSubdirs(const char *path, const ListArgs *args, const FileEntry *const *order, size_t count,
+                                    GenericVector *subdirs) {
+    ListErrorCode code = LIST_SUCCESS;
+    char *full_path = NULL;
+    size_t full_path_cap = 0;
+    for (size_t j = 0; j < count; j++) {
+        const FileEntry *entry = order[j];
+        if (!S_ISDIR(entry->statbuf.st_mode) || entry->type == DT_LNK) continue;
+        if (strcmp(entry->name, ".") == 0 || strcmp(entry->name, "..") == 0) continue;
+        if (!JoinPath(&full_path, &full_path_cap, path, entry->name)) {
+            code = LIST_ERR_MEMORY;
+            break;
+        }
+        struct stat link_stat;
+        if (entry->type == DT_UNKNOWN && args->dereference) {
+            CountStats(STATS_STAT_CALLS, 1);
+            if (lstat(full_path, &link_stat) != 0 || !S_ISDIR(link_stat.st_mode)) continue;
+        }
+        if (!AppendString(subdirs, full_path, strlen(full_path))) {
+            fprintf(stderr, "Memory allocation failed\n");
+            code = LIST_ERR_MEMORY;
+            break;
+        }
+    }
+    free(full_path);
+    return code;
+}
+
+
+// Передача посетителю готового набора записей и сбор поддиректорий
+static ListErrorCode YieldEntries(const char *path, const ListArgs *args, const ListVisitor *visitor,
+                                  const FileEntry *const *order, size_t count, GenericVector *subdirs) {
+    ListErrorCode code = visitor->entries ? visitor->entries(visitor->ctx, path, order, count) : LIST_SUCCESS;
+    if (code == LIST_SUCCESS && subdirs) {
+        code = CollectSubdirs(path, args, order, count, subdirs);
+    }
+    return code;
+}
+
+
+// Потоковый листинг без сортировки (-U, -f): записи читаются, при необходимости
+// получают stat и выдаются окнами, память не зависит от размера директории
+static ListErrorCode StreamEntries(DirReader *reader, const char *path, const ListArgs *args, StatEngines *engines,
+                                   const ListVisitor *visitor, GenericVector *subdirs) {
+    EntryStore store;
+    InitEntryStore(&store);
+    const FileEntry **order = malloc(STREAM_WINDOW_SIZE * sizeof(FileEntry *));
+    if (!order) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
+    }
+
+    ListErrorCode code = LIST_SUCCESS;
+    bool eof = false;
+    while (!eof && code == LIST_SUCCESS) {
+        ResetEntryStore(&store);
+        code = CollectEntries(reader, path, args, visitor, &store, engines, STREAM_WINDOW_SIZE, &eof);
+        if (code != LIST_SUCCESS) break;
+
+        for (size_t j = 0; j < store.count; j++) {
+            order[j] = &store.entries[j];
+        }
+        code = YieldEntries(path, args, visitor, order, store.count, subdirs);
+    }
+
+    free(order);
+    FreeEntryStore(&store);
+    return code;
+}
+
+
+// Полный листинг: все записи читаются, сортируются и выдаются одним набором
+static ListErrorCode SortedEntries(DirReader *reader, const char *path, const ListArgs *args, StatEngines *engines,
+                                   const ListVisitor *visitor, GenericVector *subdirs) {
+    EntryStore store;
+    InitEntryStore(&store);
+    bool eof;
+    ListErrorCode code = CollectEntries(reader, path, args, visitor, &store, engines, SIZE_MAX, &eof);
+    if (code != LIST_SUCCESS) {
+        FreeEntryStore(&store);
+        return code;
+    }
+
+    // Записи остаются на месте, сортируется только массив указателей (с учетом -r)
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_SORT);
+    const FileEntry **order = SortEntries(store.entries, store.count, args);
+    LeaveStatsPhase(previous);
+    if (!order) {
+        FreeEntryStore(&store);
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
+    }
+
+    code = YieldEntries(path, args, visitor, order, store.count, subdirs);
+    free(order);
+    FreeEntryStore(&store);
+    return code;
+}
+
+
+// Копия записи-поддиректории для рекурсивного обхода: имя и stat, без цели ссылки
+static bool KeepSubdirEntry(EntryStore *dirs, const FileEntry *entry) {
+    if (!S_ISDIR(entry->statbuf.st_mode) || entry->type == DT_LNK) return true;
+    FileEntry *copy = AddEntry(dirs, entry->name, entry->name_len, &entry->statbuf);
+    if (copy) copy->type = entry->type;
+    return copy != NULL;
+}
+
+
+// Первые args->top записей порядка вывода (--top N): записи читаются и получают stat
+// окнами, как в потоковом режиме, а между окнами живет только ограниченная куча
+// Вывод тот же, что у полной сортировки, обрезанной до N записей
+// С -R обход заходит во все поддиректории, а не только в попавшие в первые N: они
+// откладываются из каждого окна до кучи, и директория читается до конца
+static ListErrorCode TopEntries(DirReader *reader, const char *path, const ListArgs *args, StatEngines *engines,
+                                const ListVisitor *visitor, GenericVector *subdirs) {
+    TopHeap heap;
+    if (!InitTopHeap(&heap, args->top, args)) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
+    }
+    EntryStore window;
+    InitEntryStore(&window);
+    EntryStore dirs;
+    InitEntryStore(&dirs);
+    // Подсчет --du делится по окнам, поэтому с ним директория читается целиком
+    size_t limit = args->du ? SIZE_MAX : STREAM_WINDOW_SIZE;
+    ListErrorCode code = LIST_SUCCESS;
+    bool eof = false;
+    while (!eof && code == LIST_SUCCESS && (subdirs || !TopHeapSettled(&heap))) {
+        ResetEntryStore(&window);
+        code = CollectEntries(reader, path, args, visitor, &window, engines, limit, &eof);
+        StatsPhase previous = EnterStatsPhase(STATS_PHASE_SORT);
+        for (size_t i = 0; code == LIST_SUCCESS && i < window.count; i++) {
+            if (!OfferTopEntry(&heap, &window.entries[i]) || (subdirs && !KeepSubdirEntry(&dirs, &window.entries[i]))) {
+                fprintf(stderr, "Memory allocation failed\n");
+                code = LIST_ERR_MEMORY;
+            }
+        }
+        LeaveStatsPhase(previous);
+    }
+    FreeEntryStore(&window);
+
+    if (code == LIST_SUCCESS) {
+        StatsPhase previous = EnterStatsPhase(STATS_PHASE_SORT);
+        const FileEntry **order = SortEntries(heap.entries, heap.count, args);
+        const FileEntry **dirs_order = SortEntries(dirs.entries, dirs.count, args);
+        LeaveStatsPhase(previous);
+        if (order && dirs_order) {
+            code = YieldEntries(path, args, visitor, order, heap.count, NULL);
+            if (code == LIST_SUCCESS && subdirs) code = CollectSubdirs(path, args, dirs_order, dirs.count, subdirs);
+        } else {
+            fprintf(stderr, "Memory allocation failed\n");
+            code = LIST_ERR_MEMORY;
+        }
+        free(order);
+        free(dirs_order);
+    }
+    FreeEntryStore(&dirs);
+    FreeTopHeap(&heap);
+    return code;
+}
+
+
+// Выдача записей снимка (или только что прочитанной полной директории): фильтрация по
+// опциям на месте, затем сортировка либо окна в порядке директории
+static ListErrorCode YieldSnapshotEntries(const char *path, const ListArgs *args, const ListVisitor *visitor,
+                                          FileEntry *entries, size_t count, GenericVector *subdirs) {
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (EntryVisible(args, entries[i].name, entries[i].name_len)) entries[kept++] = entries[i];
+    }
+
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_SORT);
+    const FileEntry **order = SortEntries(entries, kept, args);
+    LeaveStatsPhase(previous);
+    if (!order) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
+    }
+    // Записи уже в памяти, --top просто обрезает готовый порядок; поддиректории
+    // для -R при этом собираются из всего порядка
+    size_t all = kept;
+    GenericVector *yield_subdirs = subdirs;
+    if (args->top > 0) {
+        if (kept > args->top) kept = args->top;
+        yield_subdirs = NULL;
+    }
+    ListErrorCode code = LIST_SUCCESS;
+    size_t window = (args->sort == SORT_NONE) ? STREAM_WINDOW_SIZE : (kept ? kept : 1);
+    for (size_t start = 0; code == LIST_SUCCESS && start < kept; start += window) {
+        size_t batch = (kept - start < window) ? kept - start : window;
+        code = YieldEntries(path, args, visitor, order + start, batch, yield_subdirs);
+    }
+    // Пустая директория тоже получает (пустой) набор, как и без кэша
+    if (kept == 0) code = YieldEntries(path, args, visitor, order, 0, yield_subdirs);
+    if (code == LIST_SUCCESS && subdirs && !yield_subdirs) {
+        code = CollectSubdirs(path, args, order, all, subdirs);
+    }
+    free(order);
+    return code;
+}
+
+
+// Чтение всей директории без фильтров со всеми метаданными и целями ссылок для снимка
+static ListErrorCode ScanForSnapshot(DirReader *reader, const char *path, const ListArgs *args, StatEngines *engines,
+                                     const ListVisitor *visitor, EntryStore *store) {
+    ListArgs scan_args = *args;
+    scan_args.all = true;
+    scan_args.almostAll = false;
+    scan_args.ignoreBackups = false;
+    ListVisitor scan_visitor = *visitor;
+    scan_visitor.need_stat = true;
+    scan_visitor.link_targets = true;
+    bool eof;
+    return CollectEntries(reader, path, &scan_args, &scan_visitor, store, engines, SIZE_MAX, &eof);
+}
+
+
+// ".." принадлежит родителю и меняется независимо от ключа снимка: с -a его stat
+// берется заново при каждом попадании
+static void RefreshParentEntry(const char *path, const ListArgs *args, FileEntry *entries, size_t count) {
+    if (!args->all) return;
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(entries[i].name, "..") != 0) continue;
+        char *buf = NULL;
+        size_t cap = 0;
+        const char *parent = JoinPath(&buf, &cap, path, "..");
+        CountStats(STATS_STAT_CALLS, 1);
+        if (parent) stat(parent, &entries[i].statbuf);
+        free(buf);
+        return;
+    }
+}
+
+
+// Листинг через снимки --cache: при попадании ни одного вызова на запись,
+// при промахе директория читается целиком и снимок перезаписывается
+static ListErrorCode VisitCachedDirectory(const char *path, const struct stat *dir_stat, const ListArgs *args, StatEngines *engines,
+                                          const ListVisitor *visitor, GenericVector *subdirs) {
+    struct stat key;
+    if (dir_stat) {
+        key = *dir_stat;
+    } else {
+        CountStats(STATS_STAT_CALLS, 1);
+        if (stat(path, &key) != 0) {
+            fprintf(stderr, "Could not open directory: %s\n", path);
+            return LIST_ERR_OPEN_DIR;
+        }
+    }
+
+    Snapshot snapshot;
+    if (LoadSnapshot(args->cacheDir, &key, args->dereference, &snapshot)) {
+        ListErrorCode code = visitor->begin_dir ? visitor->begin_dir(visitor->ctx, path, dir_stat) : LIST_SUCCESS;
+        if (code == LIST_SUCCESS) {
+            RefreshParentEntry(path, args, snapshot.entries, snapshot.count);
+            code = YieldSnapshotEntries(path, args, visitor, snapshot.entries, snapshot.count, subdirs);
+        }
+        FreeSnapshot(&snapshot);
+        if (code == LIST_SUCCESS && visitor->end_dir) {
+            code = visitor->end_dir(visitor->ctx, path);
+        }
+        return code;
+    }
+
+    DirReader reader;
+    if (!OpenListedDirectory(&reader, path)) {
+        fprintf(stderr, "Could not open directory: %s\n", path);
+        return LIST_ERR_OPEN_DIR;
+    }
+    EntryStore store;
+    InitEntryStore(&store);
+    ListErrorCode code = visitor->begin_dir ? visitor->begin_dir(visitor->ctx, path, dir_stat) : LIST_SUCCESS;
+    if (code == LIST_SUCCESS) {
+        code = ScanForSnapshot(&reader, path, args, engines, visitor, &store);
+    }
+    if (code == LIST_SUCCESS) {
+        // Снимок сохраняется, только если директория не менялась, пока ее читали,
+        // и это та же директория, stat которой стал ключом
+        struct stat after;
+        CountStats(STATS_STAT_CALLS, 1);
+        if (fstat(reader.fd, &after) == 0 && after.st_dev == key.st_dev && after.st_ino == key.st_ino &&
+            after.st_mtim.tv_sec == key.st_mtim.tv_sec && after.st_mtim.tv_nsec == key.st_mtim.tv_nsec &&
+            after.st_ctim.tv_sec == key.st_ctim.tv_sec && after.st_ctim.tv_nsec == key.st_ctim.tv_nsec) {
+            SaveSnapshot(args->cacheDir, &key, args->dereference, store.entries, store.count);
+        }
+        code = YieldSnapshotEntries(path, args, visitor, store.entries, store.count, subdirs);
+    }
+    CloseDirReader(&reader);
+    FreeEntryStore(&store);
+    if (code == LIST_SUCCESS && visitor->end_dir) {
+        code = visitor->end_dir(visitor->ctx, path);
+    }
+    return code;
+}
+
+
+ListErrorCode VisitDirectoryEntries(const char *path, const struct stat *dir_stat, const ListArgs *args, StatEngines *engines,
+                                    const ListVisitor *visitor, GenericVector *subdirs) {
+    // Размер поддеревьев зависит не только от самой директории, снимки с --du не используются
+    if (args->cacheDir && !args->du) {
+        return VisitCachedDirectory(path, dir_stat, args, engines, visitor, subdirs);
+    }
+
+    DirReader reader;
+    if (!OpenListedDirectory(&reader, path)) {
+        fprintf(stderr, "Could not open directory: %s\n", path);
+        return LIST_ERR_OPEN_DIR;
+    }
+
+    ListErrorCode code = visitor->begin_dir ? visitor->begin_dir(visitor->ctx, path, dir_stat) : LIST_SUCCESS;
+    if (code == LIST_SUCCESS) {
+        // Окна потокового режима делили бы подсчет --du, и жесткие ссылки между окнами считались бы дважды
+        if (args->top > 0) {
+            code = TopEntries(&reader, path, args, engines, visitor, subdirs);
+        } else if (args->sort == SORT_NONE && !args->du) {
+            code = StreamEntries(&reader, path, args, engines, visitor, subdirs);
+        } else {
+            code = SortedEntries(&reader, path, args, engines, visitor, subdirs);
+        }
+    }
+    CloseDirReader(&reader);
+
+    if (code == LIST_SUCCESS && visitor->end_dir) {
+        code = visitor->end_dir(visitor->ctx, path);
+    }
+    return code;
+}
+
+
+// Рекурсивный обход в порядке GNU ls -R; ошибки в поддиректориях не прерывают обход
+static ListErrorCode VisitTree(const char *path, const struct stat *dir_stat, const ListArgs *args, StatEngines *engines,
+                               const ListVisitor *visitor) {
+    GenericVector *subdirs = NewArenaVector(4);
+    if (!subdirs) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
+    }
+
+    ListErrorCode result = VisitDirectoryEntries(path, dir_stat, args, engines, visitor, subdirs);
+    for (size_t i = 0; i < GetLength(subdirs); i++) {
+        ListErrorCode code = VisitTree(GetElement(subdirs, i), NULL, args, engines, visitor);
+        if (result == LIST_SUCCESS) result = code;
+    }
+    FreeGenericVector(subdirs);
+    return result;
+}
+
+
+ListErrorCode VisitPaths(const GenericVector *paths, const ListArgs *args, const ListVisitor *visitor) {
+    StatEngines engines;
+    InitStatEngines(&engines, args);
+    EntryStore store;
+    InitEntryStore(&store);
+
+    ListErrorCode code = LIST_SUCCESS;
+    for (size_t i = 0; code == LIST_SUCCESS && i < GetLength(paths); i++) {
+        const char *path = GetElement(paths, i);
+        FileEntry entry;
+        ResetEntryStore(&store);
+        code = StatPathEntry(path, args, visitor->link_targets, &store, &entry);
+        if (code != LIST_SUCCESS) break;
+
+        if (!S_ISDIR(entry.statbuf.st_mode) || args->directory) {
+            if (args->du && S_ISDIR(entry.statbuf.st_mode) && !AggregatePathsDiskUsage(&entry, 1, args->jobs)) {
+                code = LIST_ERR_MEMORY;
+                break;
+            }
+            if (visitor->path) code = visitor->path(visitor->ctx, &entry);
+        } else if (args->recursive) {
+            code = VisitTree(path, &entry.statbuf, args, &engines, visitor);
+        } else {
+            code = VisitDirectoryEntries(path, &entry.statbuf, args, &engines, visitor, NULL);
+        }
+    }
+
+    FreeEntryStore(&store);
+    FreeStatEngines(&engines);
+    return code;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "entry_store.h"
+#include "ls.h"
+#include "stat_pool.h"
+#include "uring_stat.h"
+#include "vector.h"
+
+// Library interface of the listing: instead of being formatted, entries are handed
+// to visitor callbacks as zero-copy views into the entry store (FileEntry: name,
+// stat fields, link target). A view is valid only until its callback returns
+// Callbacks run on the calling thread in output order; a callback returning anything
+// but LIST_SUCCESS stops the current directory and its code is returned
+typedef struct ListVisitor {
+    // A path argument shown as itself: anything but a directory, or any path with -d
+    // entry->name is the path as given
+    ListErrorCode (*path)(void *ctx, const FileEntry *entry);
+    // Start of a directory listing; dir_stat is the stat of a path argument
+    // and NULL for the subdirectories reached by -R. May be NULL
+    ListErrorCode (*begin_dir)(void *ctx, const char *path, const struct stat *dir_stat);
+    // Entries of the directory in output order: a sorted listing comes as one batch,
+    // an unsorted one (SORT_NONE) in windows as it is read
+    ListErrorCode (*entries)(void *ctx, const char *path, const FileEntry *const *entries, size_t count);
+    // End of the directory listing. May be NULL
+    ListErrorCode (*end_dir)(void *ctx, const char *path);
+    void *ctx;
+    bool need_stat;      // Fill all stat fields; otherwise only what args need (st_mode from d_type at least)
+    bool link_targets;   // Fill target of symbolic links (not followed ones)
+} ListVisitor;
+
+// Walk the paths like ListPaths does (with -R descending depth-first in GNU ls -R order)
+// and hand everything to the visitor; formatting options of args are ignored
+ListErrorCode VisitPaths(const GenericVector *paths, const ListArgs *args, const ListVisitor *visitor);
+
+// Metadata engines shared by all directories of one call
+typedef struct StatEngines {
+    StatPool *pool;     // NULL - serial stat
+    UringStat *uring;   // NULL - io_uring not requested or not available
+    bool uring_failed;
+} StatEngines;
+
+// Start the engines requested by args (--jobs, --io-uring); failures fall back to serial stat
+void InitStatEngines(StatEngines *engines, const ListArgs *args);
+void FreeStatEngines(StatEngines *engines);
+
+// Stat a path argument (following links with -L) into entry; entry->name points to path
+// With link_target the target of a symbolic link is read into the store
+// Returns LIST_ERR_STAT with a message on stderr if the path does not exist
+ListErrorCode StatPathEntry(const char *path, const ListArgs *args, bool link_target, EntryStore *store, FileEntry *entry);
+
+// List one directory through the visitor (begin_dir, entries..., end_dir)
+// subdirs (if not NULL) receives the paths of the subdirectories for -R in output order,
+// copied with AppendString (into its arena for an arena vector)
+ListErrorCode VisitDirectoryEntries(const char *path, const struct stat *dir_stat, const ListArgs *args, StatEngines *engines,
+                                    const ListVisitor *visitor, GenericVector *subdirs);
+
+// Build "dir/name" in a reusable buffer; returns NULL if memory allocation failed
+char *JoinPath(char **buf, size_t *cap, const char *dir, const char *name);
+
+// Whether a directory entry is listed under -a, -A and -B
+bool EntryVisible(const ListArgs *args, const char *name, size_t name_len);
+
+// Read the target of a symbolic link of any length into a reusable buffer (not NUL-terminated)
+// size_hint is the expected length (st_size of the link); *len is the length or -1 with errno set
+// Returns false only if memory allocation failed
+bool ReadLinkTarget(int dirfd, const char *name, size_t size_hint, char **buf, size_t *cap, ssize_t *len);
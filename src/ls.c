@@ -1,25 +1,30 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
 #include <dirent.h>
 #include <sys/stat.h>
-#include <pwd.h>
-#include <grp.h>
 #include <time.h>
 #include <unistd.h>
-#include <math.h>
 #include <libgen.h>
 #include <ctype.h>
 
 #include "vector.h"
+#include "entry_store.h"
+#include "idcache.h"
+#include "listing.h"
+#include "walk.h"
+#include "outbuf.h"
+#include "sort.h"
+#include "glob.h"
+#include "glob_expand.h"
+#include "stats.h"
+#include "records.h"
+#include "watch.h"
+#include "du.h"
 #include "ls.h"
 
-typedef struct FileEntry {
-    char name[1024];
-    struct stat statbuf;
-} FileEntry;
-
 typedef struct {
     size_t block_width;
     size_t link_width;
@@ -28,507 +33,744 @@ typedef struct {
     size_t size_width;
 } ColumnWidths;
 
-// Сортировка по времени последней модификации, при равенстве - по имени
-int CompareByTime(const void *a, const void *b) {
-    const FileEntry *entryA = (const FileEntry *)a;
-    const FileEntry *entryB = (const FileEntry *)b;
-
-    if (entryA->statbuf.st_mtime != entryB->statbuf.st_mtime) {
-        return (entryB->statbuf.st_mtime - entryA->statbuf.st_mtime);
+// Предварительно отрисованные поля длинного формата (строки лежат в арене EntryStore)
+typedef struct EntryFields {
+    const char *blocks;
+    const char *links;
+    const char *user;
+    const char *group;
+    const char *size;
+    const char *time;
+} EntryFields;
+
+// Размер в формате -h/--si (buf не меньше HUMAN_SIZE_MAX байт), возвращает длину
+// Целочисленный аналог human_readable из GNU: мантисса округляется вверх, меньше 10
+// выводится с одним знаком после точки, при округлении до основания - следующая единица
+size_t FormatSize(char *buf, unsigned long long size, bool si) {
+    static const char units_1024[] = "KMGTPE";
+    static const char units_1000[] = "kMGTPE";
+    const unsigned int base = si ? 1000 : 1024;
+    const char *units = si ? units_1000 : units_1024;
+
+    if (size < base) {
+        return FormatUnsigned(buf, size);
     }
-    return strcmp(entryA->name, entryB->name);
-}
 
-// Сортировка по размеру, при равенстве - по имени
-int CompareBySize(const void *a, const void *b) {
-    const FileEntry *entryA = (const FileEntry *)a;
-    const FileEntry *entryB = (const FileEntry *)b;
+    unsigned long long amount = size;
+    unsigned int tenths = 0;
+    // 0 - остаток нулевой, 1 - меньше половины, 2 - ровно половина, 3 - больше половины
+    unsigned int rounding = 0;
+    int exponent = 0;
+    do {
+        unsigned int r10 = (unsigned int)(amount % base) * 10 + tenths;
+        unsigned int r2 = (r10 % base) * 2 + (rounding >> 1);
+        amount /= base;
+        tenths = r10 / base;
+        rounding = (r2 < base) ? (r2 + rounding != 0) : 2 + (base < r2 + rounding);
+        exponent++;
+    } while (amount >= base && exponent < (int)sizeof(units_1024) - 1);
+
+    bool point = false;
+    if (amount < 10) {
+        if (rounding > 0) {
+            tenths++;
+            rounding = 0;
+            if (tenths == 10) {
+                amount++;
+                tenths = 0;
+            }
+        }
+        if (amount < 10) {
+            point = true;
+        }
+    }
+    if (!point && tenths + rounding > 0) {
+        amount++;
+        if (amount == base && exponent < (int)sizeof(units_1024) - 1) {
+            amount = 1;
+            tenths = 0;
+            point = true;
+            exponent++;
+        }
+    }
 
-    if (entryA->statbuf.st_size != entryB->statbuf.st_size) {
-        return (entryB->statbuf.st_size - entryA->statbuf.st_size);
+    size_t len = FormatUnsigned(buf, amount);
+    if (point) {
+        buf[len++] = '.';
+        buf[len++] = (char)('0' + tenths);
     }
-    return strcmp(entryA->name, entryB->name);
+    buf[len++] = units[exponent - 1];
+    buf[len] = '\0';
+    return len;
 }
 
-// Сортировка по имени с учетом регистра
-int CompareByName(const void *a, const void *b) {
-    const FileEntry *entryA = (const FileEntry *)a;
-    const FileEntry *entryB = (const FileEntry *)b;
 
-    return strcmp(entryA->name, entryB->name);
+// Количество десятичных цифр в числе (для ширины столбцов без snprintf)
+size_t CountDigits(long long value) {
+    size_t digits = (value < 0) ? 2 : 1;
+    unsigned long long magnitude = (value < 0) ? -(unsigned long long)value : (unsigned long long)value;
+    while (magnitude >= 10) {
+        magnitude /= 10;
+        digits++;
+    }
+    return digits;
 }
 
 
-void FormatSize(char *buf, size_t bufsize, off_t size, bool human_readable, bool si) {
-    double formattedSize = (double)size;
-    int divisor = si ? 1000 : 1024;
-    const char *units[] = {"", si ? "k" : "K", "M", "G", "T"};
-    int unit_index = 0;
+// Однократная отрисовка полей записи: дальше они только выравниваются и выводятся
+bool RenderFields(const struct stat *entry_stat, const ListArgs *args, EntryStore *store, EntryFields *fields) {
+    char buf[32];
+    size_t len;
 
-    while (formattedSize >= divisor && unit_index < (sizeof(units) / sizeof(units[0])) - 1) {
-        formattedSize /= divisor;
-        unit_index++;
+    fields->blocks = NULL;
+    if (args->size) {
+        if (args->humanReadable || args->si) {
+            len = FormatSize(buf, (unsigned long long)entry_stat->st_blocks * 512, args->si);
+        } else {
+            len = FormatUnsigned(buf, (unsigned long long)(entry_stat->st_blocks / 2));
+        }
+        if (!(fields->blocks = StoreName(store, buf, len))) return false;
+    }
+
+    fields->links = NULL;
+    fields->user = NULL;
+    fields->group = NULL;
+    fields->size = NULL;
+    fields->time = NULL;
+    if (!args->longFormat) {
+        // В режиме -s без -l нужен только размер в блоках
+        return true;
     }
 
-    if (formattedSize >= 10) {
-        snprintf(buf, bufsize, "%.0f%s", formattedSize, units[unit_index]); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    len = FormatUnsigned(buf, entry_stat->st_nlink);
+    if (!(fields->links = StoreName(store, buf, len))) return false;
+
+    // Имена пользователя и группы живут в кэше до конца работы и не копируются
+    if (!(fields->user = LookupUserName(entry_stat->st_uid))) return false;
+    if (!(fields->group = LookupGroupName(entry_stat->st_gid))) return false;
+
+    if (args->humanReadable || args->si) {
+        len = FormatSize(buf, (unsigned long long)entry_stat->st_size, args->si);
     } else {
-        formattedSize = ((double)(formattedSize * 10 + 0.5)) / 10.0;
-        if ((formattedSize - floor(formattedSize)) < 0.100000) {
-            if (unit_index == 0) {
-                snprintf(buf, bufsize, "%.0f%s", formattedSize, units[unit_index]); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
-            } else {
-                snprintf(buf, bufsize, "%.1f%s", formattedSize, units[unit_index]); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
-            }
-        } else {
-            snprintf(buf, bufsize, "%.1f%s", formattedSize, units[unit_index]); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+        len = FormatUnsigned(buf, (unsigned long long)entry_stat->st_size);
+    }
+    if (!(fields->size = StoreName(store, buf, len))) return false;
+
+    // Дата и время считаются арифметически по кэшу дней, без localtime на каждую запись
+    char time_buf[256];
+    size_t time_len = FormatTimestamp(time_buf, sizeof(time_buf), &entry_stat->st_mtim, args->timeStyle, args->timeFormat);
+    if (!(fields->time = StoreName(store, time_buf, time_len))) return false;
+
+    return true;
+}
+
+
+// Учет длин отрисованных полей одной записи в ширине столбцов
+void UpdateWidths(const struct stat *entry_stat, const EntryFields *fields, const ListArgs *args, ColumnWidths *widths) {
+    if (fields->blocks) {
+        // Без -h ширина считается по st_blocks, как и раньше, хотя выводится st_blocks/2
+        size_t block_len = (args->humanReadable || args->si) ? strlen(fields->blocks) : CountDigits(entry_stat->st_blocks);
+        if (block_len > widths->block_width) {
+            widths->block_width = block_len;
         }
+    }
+    if (!fields->links) return;
 
+    size_t link_len = strlen(fields->links);
+    if (link_len > widths->link_width) {
+        widths->link_width = link_len;
     }
-}
 
+    size_t user_len = strlen(fields->user);
+    if (user_len > widths->user_width) {
+        widths->user_width = user_len;
+    }
 
-void CalculateMaxWidths(const FileEntry *entries, size_t entry_count, ColumnWidths *widths, const ListArgs *args) {
-    widths->block_width = 0;
-    widths->link_width = 0;
-    widths->user_width = 0;
-    widths->group_width = 0;
-    widths->size_width = 0;
+    size_t group_len = strlen(fields->group);
+    if (group_len > widths->group_width) {
+        widths->group_width = group_len;
+    }
 
-    for (size_t i = 0; i < entry_count; i++) {
-        const struct stat *entry_stat = &entries[i].statbuf;
-
-        // Размер блока
-        if (args->size) {
-            long blocks = entry_stat->st_blocks;
-            char block_str[20];
-            if (args->humanReadable || args->si) {
-                FormatSize(block_str, sizeof(block_str), blocks * 512, args->humanReadable, args->si);
-
-                size_t block_len = strlen(block_str);
-                if (block_len > widths->block_width) {
-                    widths->block_width = block_len;
-                }
-            } else {
-                size_t block_len = (size_t)snprintf(NULL, 0, "%ld", entry_stat->st_blocks); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
-                if (block_len > widths->block_width) {
-                    widths->block_width = block_len;
-                }
-            }
-        }
+    size_t size_len = strlen(fields->size);
+    if (size_len > widths->size_width) {
+        widths->size_width = size_len;
+    }
+}
 
-        // Количество ссылок
-        size_t link_len = (size_t)snprintf(NULL, 0, "%lu", entry_stat->st_nlink); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
-        if (link_len > widths->link_width) {
-            widths->link_width = link_len;
-        }
 
-        // Имя пользователя
-        struct passwd *pwd = getpwuid(entry_stat->st_uid);
-        size_t user_len = strlen(pwd ? pwd->pw_name : "?");
-        if (user_len > widths->user_width) {
-            widths->user_width = user_len;
-        }
+// Единственный проход по записям: отрисовка полей каждой записи и подсчет ширины столбцов
+// (widths только увеличивается, обнуляет ее вызывающий)
+bool CalculateMaxWidths(const FileEntry *const *order, size_t entry_count, EntryFields *fields, EntryStore *store, ColumnWidths *widths, const ListArgs *args) {
+    for (size_t i = 0; i < entry_count; i++) {
+        if (!RenderFields(&order[i]->statbuf, args, store, &fields[i])) return false;
+        UpdateWidths(&order[i]->statbuf, &fields[i], args, widths);
+    }
+    return true;
+}
 
-        // Имя группы
-        struct group *grp = getgrgid(entry_stat->st_gid);
-        size_t group_len = strlen(grp ? grp->gr_name : "?");
-        if (group_len > widths->group_width) {
-            widths->group_width = group_len;
-        }
 
-        // Размер файла
-        char size_str[20];
-        if (args->humanReadable || args->si) {
-            FormatSize(size_str, sizeof(size_str), entry_stat->st_size, args->humanReadable, args->si);
-        
-            size_t size_len = strlen(size_str);
-            if (size_len > widths->size_width) {
-                widths->size_width = size_len;
+#define COLOR_DIR "\033[36m"
+#define COLOR_LINK "\033[31m"
+#define COLOR_RESET "\033[0m"
+
+// Вывод имени записи; name - отображаемое имя либо NULL, тогда берется basename(path)
+// Цель ссылки уже прочитана при сканировании; если прочитать ее не удалось (ошибка уже
+// сообщена), ссылка выводится без цели, как в GNU ls
+void PrintName(OutBuf *ob, char *path, const char *name, const FileEntry *entry, const ListArgs *args, bool color) {
+    const struct stat *entry_stat = &entry->statbuf;
+    if (S_ISDIR(entry_stat->st_mode)) {
+        const char *shown = args->directory ? path : (name ? name : basename(path));
+        if (color) OUT_LITERAL(ob, COLOR_DIR);
+        OutStr(ob, shown);
+        if (color) OUT_LITERAL(ob, COLOR_RESET);
+        OutChar(ob, '\n');
+    } else {
+        if (S_ISLNK(entry_stat->st_mode) && !args->dereference) {
+            OUT_LITERAL(ob, COLOR_LINK);
+            OutStr(ob, name ? name : basename(path));
+            OUT_LITERAL(ob, COLOR_RESET);
+            if (entry->target) {
+                OUT_LITERAL(ob, " -> " COLOR_LINK);
+                OutWrite(ob, entry->target, entry->target_len);
+                OUT_LITERAL(ob, COLOR_RESET);
             }
+            OutChar(ob, '\n');
         } else {
-            size_t size_len = (size_t)snprintf(NULL, 0, "%ld", entry_stat->st_size); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
-            if (size_len > widths->size_width) {
-                widths->size_width = size_len;
-            }
+            OutStr(ob, name ? name : basename(path));
+            OutChar(ob, '\n');
         }
     }
 }
 
 
-void PrintLongFormat(FILE *out, char *path, const struct stat *entry_stat, const ListArgs *args, const ColumnWidths *widths) {
+void PrintLongFormat(OutBuf *ob, char *path, const char *name, const FileEntry *entry, const EntryFields *fields, const ListArgs *args, const ColumnWidths *widths, bool color) {
+    const struct stat *entry_stat = &entry->statbuf;
+    if (args->size) {
+        OutPadLeft(ob, fields->blocks, widths->block_width);
+        OutChar(ob, ' ');
+    }
 
-    if (args->size && !args->longFormat) {
-        long blocks = entry_stat->st_blocks;
-        char block_str[20];
-        if (args->humanReadable || args->si) {
-            FormatSize(block_str, sizeof(block_str), blocks * 512, args->humanReadable, args->si);
-            fprintf(out, "%*s ", (int)widths->block_width, block_str);
-        } else {
-            fprintf(out, "%*ld ", (int)widths->block_width, entry_stat->st_blocks/2);
-        }
+    if (args->longFormat) {
+        OutChar(ob, S_ISDIR(entry_stat->st_mode) ? 'd' : (S_ISLNK(entry_stat->st_mode) ? 'l' : '-'));
+        OutModeBits(ob, entry_stat->st_mode);
+        OutChar(ob, ' ');
+
+        OutPadLeft(ob, fields->links, widths->link_width);
+        OutChar(ob, ' ');
+        OutPadRight(ob, fields->user, widths->user_width);
+        OutChar(ob, ' ');
+        OutPadRight(ob, fields->group, widths->group_width);
+        OutChar(ob, ' ');
+        OutPadLeft(ob, fields->size, widths->size_width);
+        OutChar(ob, ' ');
+        OutStr(ob, fields->time);
+        OutChar(ob, ' ');
+    }
 
-        if (S_ISDIR(entry_stat->st_mode)) {
-            if ((out != stdout) && (out != stderr)) {
-                if (args->directory) {fprintf(out, "%s\n", path);}
-                else {fprintf(out, "%s\n", basename(path));}
-            } else {
-                if (args->directory) {fprintf(out, "\033[36m%s\033[0m\n", path);}
-                else {fprintf(out, "\033[36m%s\033[0m\n", basename(path));}
-            }
-        } else {
-            if (S_ISLNK(entry_stat->st_mode) && !args->dereference) {
-                char link_target[1024];
-                ssize_t len = readlink(path, link_target, sizeof(link_target) - 1);
-                if (len != -1) {
-                    link_target[len] = '\0';
-                    fprintf(out, "\033[31m%s\033[0m -> \033[31m%s\033[0m\n", basename(path), link_target);
-                } else {
-                    perror("readlink");
-                }
-            } else {
-                fprintf(out, "%s\n", basename(path));
-            }
-        }
+    PrintName(ob, path, name, entry, args, color);
+}
 
-    } else {
-        if (args->size) {
-            long blocks = entry_stat->st_blocks;
-            char block_str[20];
-            if (args->humanReadable || args->si) {
-                FormatSize(block_str, sizeof(block_str), blocks * 512, args->humanReadable, args->si);
-                fprintf(out, "%*s ", (int)widths->block_width, block_str);
-            } else {
-                fprintf(out, "%*ld ", (int)widths->block_width, entry_stat->st_blocks/2);
-            }
-        }
-        
-        fprintf(out, "%c", S_ISDIR(entry_stat->st_mode) ? 'd' : (S_ISLNK(entry_stat->st_mode) ? 'l' : '-'));
-        fprintf(out, "%c", (entry_stat->st_mode & S_IRUSR) ? 'r' : '-');
-        fprintf(out, "%c", (entry_stat->st_mode & S_IWUSR) ? 'w' : '-');
-        fprintf(out, "%c", (entry_stat->st_mode & S_IXUSR) ? 'x' : '-');
-        fprintf(out, "%c", (entry_stat->st_mode & S_IRGRP) ? 'r' : '-');
-        fprintf(out, "%c", (entry_stat->st_mode & S_IWGRP) ? 'w' : '-');
-        fprintf(out, "%c", (entry_stat->st_mode & S_IXGRP) ? 'x' : '-');
-        fprintf(out, "%c", (entry_stat->st_mode & S_IROTH) ? 'r' : '-');
-        fprintf(out, "%c", (entry_stat->st_mode & S_IWOTH) ? 'w' : '-');
-        fprintf(out, "%c ", (entry_stat->st_mode & S_IXOTH) ? 'x' : '-');
-
-        fprintf(out, "%*lu ", (int)widths->link_width, entry_stat->st_nlink);
-
-        struct passwd *pwd = getpwuid(entry_stat->st_uid);
-        fprintf(out, "%-*s ", (int)widths->user_width, pwd ? pwd->pw_name : "?");
-
-        struct group *grp = getgrgid(entry_stat->st_gid);
-        fprintf(out, "%-*s ", (int)widths->group_width, grp ? grp->gr_name : "?");
-
-        char size_str[20];
-        if (args->humanReadable || args->si) {
-            FormatSize(size_str, sizeof(size_str), entry_stat->st_size, args->humanReadable, args->si);
-            fprintf(out, "%*s ", (int)widths->size_width, size_str);
-        } else {
-            fprintf(out, "%*ld ", (int)widths->size_width, entry_stat->st_size);
-        }
 
-        char timeBuf[20];
-        struct tm *timeinfo = localtime(&entry_stat->st_mtime);
-        strftime(timeBuf, sizeof(timeBuf), "%b %e %H:%M", timeinfo);
-        fprintf(out, "%s ", timeBuf);
-
-        if (S_ISDIR(entry_stat->st_mode)) {
-            if ((out != stdout) && (out != stderr)) {
-                if (args->directory) {fprintf(out, "%s\n", path);}
-                else {fprintf(out, "%s\n", basename(path));}
-            } else {
-                if (args->directory) {fprintf(out, "\033[36m%s\033[0m\n", path);}
-                else {fprintf(out, "\033[36m%s\033[0m\n", basename(path));}
-            }
-        } else {
-            if (S_ISLNK(entry_stat->st_mode) && !args->dereference) {
-                char link_target[1024];
-                ssize_t len = readlink(path, link_target, sizeof(link_target) - 1);
-                if (len != -1) {
-                    link_target[len] = '\0';
-                    fprintf(out, "\033[31m%s\033[0m -> \033[31m%s\033[0m\n", basename(path), link_target);
-                } else {
-                    perror("readlink");
-                }
-            } else {
-            fprintf(out, "%s\n", basename(path));
-            }
-        }
+// Вывод одиночного пути (файла или самой директории) в длинном формате
+ListErrorCode PrintSingleEntry(OutBuf *ob, char *path, const FileEntry *entry, const ListArgs *args, bool color) {
+    EntryStore store;
+    EntryFields fields;
+    // Одиночная строка выравнивается только по ширине блоков
+    ColumnWidths widths = {0};
+    widths.block_width = 1;
+
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_FORMAT);
+    InitEntryStore(&store);
+    if (!RenderFields(&entry->statbuf, args, &store, &fields)) {
+        FreeEntryStore(&store);
+        LeaveStatsPhase(previous);
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
     }
+    PrintLongFormat(ob, path, NULL, entry, &fields, args, &widths, color);
+    FreeEntryStore(&store);
+    LeaveStatsPhase(previous);
+    return LIST_SUCCESS;
 }
 
 
-// Проверяет совпадение строки с шаблоном (с `*` и `?`)
-bool MatchPattern(const char* pattern, const char* str) {
-    if (*pattern == '\0' && *str == '\0') {
-        return true;
+// Интерфейс для выполнения глоббинга перед обработкой путей
+// Все шаблоны раскрываются за один проход; пути без шаблонов и шаблоны
+// без совпадений остаются на своих местах как есть
+// Результат собирается в векторе с ареной: совпадения переносятся вместе с аренами
+// шаблонов, остальные пути копируются в арену, так что строки не выделяются по одной
+void ExpandPathsWithGlob(GenericVector *paths) {
+    size_t length = GetLength(paths);
+    const char **patterns = malloc((length ? length : 1) * sizeof(char *));
+    GenericVector **matches = calloc(length ? length : 1, sizeof(GenericVector *));
+    if (!patterns || !matches) {
+        fprintf(stderr, "Memory allocation failed for glob patterns.\n");
+        exit(EXIT_FAILURE); // Немедленный выход
     }
 
-    if (*pattern == '*') {
-        while (*(pattern + 1) == '*') {
-            pattern++;
+    size_t pattern_count = 0;
+    for (size_t i = 0; i < length; i++) {
+        const char *path = GetElement(paths, i);
+        if (!HasGlobMeta(path)) continue;
+        patterns[pattern_count] = path;
+        matches[pattern_count] = NewArenaVector(0);
+        if (!matches[pattern_count]) {
+            fprintf(stderr, "Memory allocation failed for glob matches.\n");
+            exit(EXIT_FAILURE);
         }
-        
-        // Если звездочка - последний символ
-        if (*(pattern + 1) == '\0') {
-            return true;
+        pattern_count++;
+    }
+
+    if (pattern_count > 0) {
+        if (!ExpandGlobPatterns(patterns, pattern_count, matches)) {
+            fprintf(stderr, "Memory allocation failed during glob expansion.\n");
+            exit(EXIT_FAILURE);
         }
 
-        while (*str != '\0') {
-            if (MatchPattern(pattern + 1, str)) {
-                return true;
+        size_t total = length;
+        for (size_t k = 0; k < pattern_count; k++) {
+            total += GetLength(matches[k]);
+        }
+        GenericVector *expanded = NewArenaVector(total);
+        if (!expanded) {
+            fprintf(stderr, "Memory allocation failed for expanded_paths.\n");
+            exit(EXIT_FAILURE);
+        }
+        size_t k = 0;
+        for (size_t i = 0; i < length; i++) {
+            const char *path = GetElement(paths, i);
+            bool is_pattern = k < pattern_count && patterns[k] == path;
+            bool ok = (is_pattern && GetLength(matches[k]) > 0) ? Extend(expanded, matches[k])
+                                                                : AppendString(expanded, path, strlen(path)) != NULL;
+            if (!ok) {
+                fprintf(stderr, "Memory allocation failed for expanded_paths.\n");
+                exit(EXIT_FAILURE);
             }
-            str++;
+            if (is_pattern) k++;
         }
-        return MatchPattern(pattern + 1, str);
+        SwapGenericVectors(paths, expanded);
+        FreeGenericVector(expanded);
     }
-    
-    if (*str != '\0' && (*pattern == '?' || *pattern == *str)) {
-        return MatchPattern(pattern + 1, str + 1);
+
+    for (size_t k = 0; k < pattern_count; k++) {
+        FreeGenericVector(matches[k]);
     }
-    
-    return false;
+    free(matches);
+    free(patterns);
 }
 
 
-// Глоббинг: находит файлы, соответствующие шаблону
-int CustomGlob(const char *pattern, GenericVector *results) {
-    char dir_path[1024];
-    const char *file_pattern = strrchr(pattern, '/');
-    if (file_pattern) {
-        snprintf(dir_path, sizeof(dir_path), "%.*s", (int)(file_pattern - pattern), pattern); //NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
-        file_pattern++; // Шаблон файла
+// Отрисовка листинга поверх ListVisitor: текст в стиле ls либо машиночитаемые записи
+typedef struct TextRenderer {
+    const ListArgs *args;
+    OutBuf *ob;
+    bool color;
+    ColumnWidths widths;   // Только растет: в потоковом режиме копится между окнами
+    EntryStore fields;     // Арена отрисованных полей текущего набора
+    char *path_buf;
+    size_t path_cap;
+} TextRenderer;
+
+
+// Строка "total" длинного формата по блокам всех записей директории
+void PrintTotal(OutBuf *ob, const ListArgs *args, const FileEntry *const *order, size_t entry_count) {
+    // 64-битная сумма: в int блоки больших директорий (и поддеревьев с --du) переполнялись
+    long long total = 0;
+    for (size_t j = 0; j < entry_count; j++) {
+        total += order[j]->statbuf.st_blocks;
+    }
+
+    char total_buf[HUMAN_SIZE_MAX];
+    if (args->humanReadable || args->si) {
+        size_t total_len = FormatSize(total_buf, (unsigned long long)total * 512, args->si);
+        OUT_LITERAL(ob, "total ");
+        OutWrite(ob, total_buf, total_len);
+        OutChar(ob, '\n');
     } else {
-        strcpy(dir_path, ".");
-        file_pattern = pattern;
+        long long half = total / 2;
+        OUT_LITERAL(ob, "total ");
+        if (half < 0) {
+            OutChar(ob, '-');
+            half = -half;
+        }
+        OutUnsigned(ob, (unsigned long long)half);
+        OutChar(ob, '\n');
     }
+}
+
+
+ListErrorCode TextBeginDir(void *ctx, const char *path, const struct stat *dir_stat) {
+    (void)path;
+    (void)dir_stat;
+    TextRenderer *renderer = ctx;
+    memset(&renderer->widths, 0, sizeof(renderer->widths));
+    return LIST_SUCCESS;
+}
+
 
-    DIR *dir = opendir(dir_path);
-    if (!dir) {
-        fprintf(stderr, "Cannot open directory: %s\n", dir_path);
-        return -1;
+// Строки набора записей; marks (если не NULL) - пометка перед каждой строкой
+ListErrorCode PrintEntryLines(TextRenderer *renderer, const char *path, const FileEntry *const *order, size_t entry_count,
+                              const char *marks) {
+    const ListArgs *args = renderer->args;
+    OutBuf *ob = renderer->ob;
+    ListErrorCode code = LIST_SUCCESS;
+
+    // Поля отрисовываются один раз до вывода, вывод только выравнивает их
+    EntryFields *fields = NULL;
+    if (args->size || args->longFormat) {
+        ResetEntryStore(&renderer->fields);
+        fields = malloc((entry_count ? entry_count : 1) * sizeof(EntryFields));
+        if (!fields || !CalculateMaxWidths(order, entry_count, fields, &renderer->fields, &renderer->widths, args)) {
+            free(fields);
+            fprintf(stderr, "Memory allocation failed\n");
+            return LIST_ERR_MEMORY;
+        }
     }
 
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (MatchPattern(file_pattern, entry->d_name)) {
-            size_t path_len = strlen(dir_path) + strlen(entry->d_name) + 2;
-            char *full_path = malloc(path_len);
-            if (!full_path) {
-                fprintf(stderr, "Memory allocation failed\n");
-                closedir(dir);
-                return -1;
+    for (size_t j = 0; j < entry_count; j++) {
+        const FileEntry *entry = order[j];
+        if (marks) {
+            OutChar(ob, marks[j]);
+            OutChar(ob, ' ');
+        }
+        if (args->size || args->longFormat) {
+            if (!JoinPath(&renderer->path_buf, &renderer->path_cap, path, entry->name)) {
+                code = LIST_ERR_MEMORY;
+                break;
             }
-            snprintf(full_path, path_len, "%s/%s", dir_path, entry->d_name); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
-            Append(results, full_path);
+            PrintLongFormat(ob, renderer->path_buf, entry->name, entry, &fields[j], args, &renderer->widths, renderer->color);
+        } else {
+            OutWrite(ob, entry->name, entry->name_len);
+            OutChar(ob, '\n');
         }
     }
+    free(fields);
+    return code;
+}
+
+
+// Вывод набора записей в заданном порядке: всей директории либо окна потокового режима
+ListErrorCode TextEntries(void *ctx, const char *path, const FileEntry *const *order, size_t entry_count) {
+    TextRenderer *renderer = ctx;
+    const ListArgs *args = renderer->args;
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_FORMAT);
+
+    // Отсортированная директория приходит одним набором, итог считается по нему
+    if (args->longFormat && args->sort != SORT_NONE) {
+        PrintTotal(renderer->ob, args, order, entry_count);
+    }
+    ListErrorCode code = PrintEntryLines(renderer, path, order, entry_count, NULL);
+    // Каждое окно потокового режима сразу уходит в вывод
+    if (args->sort == SORT_NONE) FlushOutBuf(renderer->ob);
 
-    closedir(dir);
-    return 0;
+    LeaveStatsPhase(previous);
+    return code;
 }
 
 
-// Проверка наличия шаблона в строке
-bool ContainsGlobPattern(const char *path) {
-    while (*path) {
-        if (*path == '*' || *path == '?') {
-            return true;
+// Машиночитаемые записи идут прямо из хранилища, без полей и ширин
+ListErrorCode RecordEntries(void *ctx, const char *path, const FileEntry *const *order, size_t entry_count) {
+    TextRenderer *renderer = ctx;
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_FORMAT);
+    ListErrorCode code = LIST_SUCCESS;
+    for (size_t j = 0; j < entry_count; j++) {
+        const FileEntry *entry = order[j];
+        if (!JoinPath(&renderer->path_buf, &renderer->path_cap, path, entry->name)) {
+            code = LIST_ERR_MEMORY;
+            break;
         }
-        path++;
+        OutRecord(renderer->ob, renderer->args, renderer->path_buf, &entry->statbuf, entry->target, entry->target_len);
     }
-    return false;
+    if (renderer->args->sort == SORT_NONE) FlushOutBuf(renderer->ob);
+    LeaveStatsPhase(previous);
+    return code;
 }
 
-// Интерфейс для выполнения глоббинга перед обработкой путей
-void ExpandPathsWithGlob(GenericVector *paths) {
-    size_t original_length = GetLength(paths);
-    GenericVector *expanded_paths = NewGenericVector(1);
-    if (!expanded_paths) {
-        fprintf(stderr, "Memory allocation failed for expanded_paths.\n");
-        exit(EXIT_FAILURE); // Немедленный выход
+
+// Посетитель, выводящий директории в ob; аргументы-пути ListPaths выводит сам
+void InitTextRenderer(TextRenderer *renderer, ListVisitor *visitor, const ListArgs *args, OutBuf *ob, bool color) {
+    memset(renderer, 0, sizeof(*renderer));
+    renderer->args = args;
+    renderer->ob = ob;
+    renderer->color = color;
+    InitEntryStore(&renderer->fields);
+
+    bool records = (args->format != FORMAT_TEXT);
+    visitor->path = NULL;
+    visitor->begin_dir = TextBeginDir;
+    visitor->entries = records ? RecordEntries : TextEntries;
+    visitor->end_dir = NULL;
+    visitor->ctx = renderer;
+    visitor->need_stat = records || args->longFormat || args->size;
+    // Цели ссылок выводятся только рядом с отрисованными полями
+    visitor->link_targets = records || args->longFormat || args->size;
+}
+
+
+void FreeTextRenderer(TextRenderer *renderer) {
+    FreeEntryStore(&renderer->fields);
+    free(renderer->path_buf);
+}
+
+
+// Контекст обхода дерева для VisitDirectory
+typedef struct WalkContext {
+    const ListArgs *args;
+    bool color;
+    StatEngines *engines;
+} WalkContext;
+
+ListErrorCode VisitDirectory(const char *path, FILE *out, GenericVector *subdirs, void *arg) {
+    const WalkContext *ctx = arg;
+    // Потоки обхода учитываются только на время работы над директорией
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_OTHER);
+    OutBuf ob;
+    if (!InitOutBuf(&ob, out)) {
+        LeaveStatsPhase(previous);
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
     }
+    // У каждой директории свой вывод, поэтому и свой посетитель
+    TextRenderer renderer;
+    ListVisitor visitor;
+    InitTextRenderer(&renderer, &visitor, ctx->args, &ob, ctx->color);
+    ListErrorCode code = VisitDirectoryEntries(path, NULL, ctx->args, ctx->engines, &visitor, subdirs);
+    FreeTextRenderer(&renderer);
+    FreeOutBuf(&ob);
+    LeaveStatsPhase(previous);
+    return code;
+}
 
-    for (size_t i = 0; i < original_length; i++) {
-        char *path = (char *)GetElement(paths, i);
-        if (ContainsGlobPattern(path)) {
-            if (CustomGlob(path, expanded_paths) != 0) {
-                fprintf(stderr, "Error in CustomGlob for path: %s\n", path);
-                FreeGenericVector(expanded_paths);
-                exit(EXIT_FAILURE);
-            }
-        } else {
-            char *copy = strdup(path);
-            if (!copy) {
-                fprintf(stderr, "Memory allocation failed for path copy.\n");
-                FreeGenericVector(expanded_paths);
-                exit(EXIT_FAILURE);
-            }
-            Append(expanded_paths, copy);
+
+// Вывод одного аргумента-пути: сам путь либо содержимое директории
+// Порядок проверок повторяет исходный ls, включая вывод директории с -s перед ее содержимым
+ListErrorCode ListPath(char *path, const ListArgs *args, OutBuf *ob, bool color, StatEngines *engines, const ListVisitor *visitor,
+                       EntryStore *store, bool *printed_tree) {
+    FileEntry entry;
+    ResetEntryStore(store);
+    ListErrorCode code = StatPathEntry(path, args, args->format != FORMAT_TEXT, store, &entry);
+    if (code != LIST_SUCCESS) return code;
+    const struct stat *path_stat = &entry.statbuf;
+
+    // С --du строка самой директории (-s или -d) показывает размер всего поддерева,
+    // как и строки ее записей
+    bool dir_line = args->directory || (!args->longFormat && args->format == FORMAT_TEXT);
+    if (args->du && S_ISDIR(path_stat->st_mode) && dir_line && !AggregatePathsDiskUsage(&entry, 1, args->jobs)) {
+        return LIST_ERR_MEMORY;
+    }
+
+    if (args->format != FORMAT_TEXT && (!S_ISDIR(path_stat->st_mode) || args->directory)) {
+        // Запись о самом пути; директории без -d раскрываются ниже
+        OutRecord(ob, args, path, path_stat, entry.target, entry.target_len);
+        return LIST_SUCCESS;
+    }
+
+    if (S_ISREG(path_stat->st_mode)) {
+        // Обработка, если это файл
+        if (args->size || args->longFormat) {
+            return PrintSingleEntry(ob, path, &entry, args, color);
+        }
+        OutStr(ob, path);
+        OutChar(ob, '\n');
+        return LIST_SUCCESS;
+    }
+    if (!S_ISDIR(path_stat->st_mode)) {
+        OutStr(ob, path);
+        OutChar(ob, '\n');
+        return LIST_SUCCESS;
+    }
+
+    // Обработка директории (в машиночитаемых форматах строки о ней нет)
+    if (args->size && !args->longFormat && args->format == FORMAT_TEXT) {
+        code = PrintSingleEntry(ob, path, &entry, args, color);
+        // -d с --du ограничивается итогом, как du -s; без --du содержимое выводится, как в исходном ls
+        if (code != LIST_SUCCESS || (args->du && args->directory)) return code;
+    } else if (args->directory) {
+        if (args->longFormat) {
+            return PrintSingleEntry(ob, path, &entry, args, color);
         }
+        OUT_LITERAL(ob, COLOR_DIR);
+        OutStr(ob, path);
+        OUT_LITERAL(ob, COLOR_RESET "\n");
+        return LIST_SUCCESS;
     }
 
-    FreeGenericVector(paths);
-    for (size_t i = 0; i < GetLength(expanded_paths); i++) {
-        Append(paths, GetElement(expanded_paths, i));
+    if (!args->recursive) {
+        return VisitDirectoryEntries(path, path_stat, args, engines, visitor, NULL);
     }
 
-    FreeGenericVector(expanded_paths);
+    // Пустая строка отделяет деревья разных аргументов, как в GNU ls -R
+    bool headers = (args->format == FORMAT_TEXT);
+    if (*printed_tree && headers) OutChar(ob, '\n');
+    *printed_tree = true;
+    WalkContext ctx = {args, color, engines};
+    StatEngines serial = {NULL, NULL, false};
+    if (args->jobs > 1) {
+        // Параллелизм переносится на уровень директорий, stat внутри каждой - последовательный
+        ctx.engines = &serial;
+    }
+    // Обход пишет в поток сам: буфер сбрасывается до него, поток - после
+    FILE *out = ob->stream;
+    FlushOutBuf(ob);
+    code = WalkTree(path, args->jobs, headers, VisitDirectory, &ctx, out);
+    fflush(out);
+    return code;
 }
 
 
-ListErrorCode ListPaths(const GenericVector* paths, const ListArgs* args, FILE* out) {
-    for (size_t i = 0; i < GetLength(paths); i++) {
-        char *path = (char*)GetElement(paths, i);
-        struct stat path_stat;
-        FileEntry *entries = NULL;
-        size_t entry_count = 0;
-
-        if (args->dereference) {
-            if (stat(path, &path_stat) != 0) {
-                fprintf(stderr, "Error retrieving info for %s\n", path);
-                return LIST_ERR_STAT;
+// Вывод изменений --watch
+typedef struct WatchOutput {
+    TextRenderer *renderer;
+    bool headers;  // Следим за несколькими директориями: перед изменениями строка "path:"
+} WatchOutput;
+
+// Строки листинга с пометками "+ " (новая запись), "- " (удаленная), "~ " (измененная)
+// либо записи с полем события; каждая пачка сразу уходит в вывод
+ListErrorCode WatchChanges(void *ctx, const char *path, const FileEntry *const *order, const WatchChange *kinds, size_t count) {
+    static const char *const events[] = {"added", "removed", "changed"};
+    static const char event_marks[] = {'+', '-', '~'};
+    WatchOutput *output = ctx;
+    TextRenderer *renderer = output->renderer;
+    const ListArgs *args = renderer->args;
+    OutBuf *ob = renderer->ob;
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_FORMAT);
+    ListErrorCode code = LIST_SUCCESS;
+
+    if (args->format != FORMAT_TEXT) {
+        for (size_t j = 0; j < count; j++) {
+            const FileEntry *entry = order[j];
+            if (!JoinPath(&renderer->path_buf, &renderer->path_cap, path, entry->name)) {
+                code = LIST_ERR_MEMORY;
+                break;
             }
+            OutEventRecord(ob, args, events[kinds[j]], renderer->path_buf, &entry->statbuf, entry->target, entry->target_len);
+        }
+    } else {
+        char *marks = malloc(count);
+        if (!marks) {
+            LeaveStatsPhase(previous);
+            fprintf(stderr, "Memory allocation failed\n");
+            return LIST_ERR_MEMORY;
+        }
+        for (size_t j = 0; j < count; j++) {
+            marks[j] = event_marks[kinds[j]];
+        }
+        if (output->headers) {
+            OutStr(ob, path);
+            OUT_LITERAL(ob, ":\n");
+        }
+        // Столбцы выравниваются в пределах пачки
+        memset(&renderer->widths, 0, sizeof(renderer->widths));
+        code = PrintEntryLines(renderer, path, order, count, marks);
+        free(marks);
+    }
+    FlushOutBuf(ob);
+    LeaveStatsPhase(previous);
+    return code;
+}
+
+
+// --watch: аргументы выводятся как обычно, директории без -d затем отслеживаются,
+// пока не исчезнут все или сигнал не прервет ожидание
+ListErrorCode WatchPaths(const GenericVector* paths, const ListArgs* args, FILE* out) {
+    if (args->recursive || args->directory || args->du || args->top > 0) {
+        fprintf(stderr, "--watch cannot be combined with -R, -d, --du or --top\n");
+        return LIST_ERR_INVALID_ARG;
+    }
+    DirWatch *watch = NewDirWatch(args);
+    if (!watch) return LIST_ERR_OPEN_DIR;
+    OutBuf ob;
+    if (!InitOutBuf(&ob, out)) {
+        FreeDirWatch(watch);
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
+    }
+    StatEngines engines;
+    InitStatEngines(&engines, args);
+
+    bool color = (out == stdout) || (out == stderr);
+    TextRenderer renderer;
+    ListVisitor visitor;
+    InitTextRenderer(&renderer, &visitor, args, &ob, color);
+    EntryStore store;
+    InitEntryStore(&store);
+    bool printed_tree = false;
+
+    ListErrorCode result = LIST_SUCCESS;
+    size_t watched = 0;
+    for (size_t i = 0; result == LIST_SUCCESS && i < GetLength(paths); i++) {
+        char *path = GetElement(paths, i);
+        FileEntry entry;
+        ResetEntryStore(&store);
+        result = StatPathEntry(path, args, false, &store, &entry);
+        if (result != LIST_SUCCESS) break;
+        if (S_ISDIR(entry.statbuf.st_mode)) {
+            result = AddWatchedDirectory(watch, path, &entry.statbuf, &engines, &visitor);
+            watched++;
         } else {
-            if (lstat(path, &path_stat) != 0) {
-                fprintf(stderr, "Error retrieving info for %s\n", path);
-                return LIST_ERR_STAT;
-            }
+            result = ListPath(path, args, &ob, color, &engines, &visitor, &store, &printed_tree);
         }
+    }
+    FlushOutBuf(&ob);
 
-        if (S_ISREG(path_stat.st_mode)) {
-            // Обработка, если это файл
-            if (args->size && !args->longFormat) {
-                ColumnWidths widths = {1};
-                PrintLongFormat(out, path, &path_stat, args, &widths);
-            } else {
-                if (args->longFormat) {
-                    ColumnWidths widths = {1};
-                    PrintLongFormat(out, path, &path_stat, args, &widths);
-                } else {
-                    fprintf(out, "%s\n", path);
-                }
-                continue;
-            }
+    if (result == LIST_SUCCESS && watched > 0) {
+        WatchOutput output = {&renderer, watched > 1};
+        WatchSink sink = {WatchChanges, &output};
+        result = RunDirWatch(watch, &sink);
+    }
 
-        } else if (S_ISDIR(path_stat.st_mode)) {
-            // Обработка директории
-            if (args->size && !args->longFormat) {
-                ColumnWidths widths = {1}; 
-                PrintLongFormat(out, path, &path_stat, args, &widths);
-            } else {
-                if (args->directory) {
-                    if (args->longFormat) {
-                        ColumnWidths widths = {1}; 
-                        PrintLongFormat(out, path, &path_stat, args, &widths);
-                    } else {
-                        fprintf(out, "\033[36m%s\033[0m\n", path);
-                    }
-                    continue;
-                }
-            }
+    FreeEntryStore(&store);
+    FreeTextRenderer(&renderer);
+    FreeOutBuf(&ob);
+    FreeStatEngines(&engines);
+    FreeDirWatch(watch);
+    return result;
+}
 
-            DIR *dir = opendir(path);
-            if (!dir) {
-                fprintf(stderr, "Could not open directory: %s\n", path);
-                return LIST_ERR_OPEN_DIR;
-            }
 
-            struct dirent *entry;
-            while ((entry = readdir(dir)) != NULL) {
-                if (!args->all && entry->d_name[0] == '.') continue;
-                if (args->almostAll && (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)) continue;
-                if (args->ignoreBackups && entry->d_name[strlen(entry->d_name) - 1] == '~') continue;
-
-                FileEntry *temp_entries = realloc(entries, (entry_count + 1) * sizeof(FileEntry));
-                if (!temp_entries) {
-                    free(entries);  // Освобождение памяти, если realloc не удастся
-                    fprintf(stderr, "Memory allocation failed\n");
-                    closedir(dir);
-                    return LIST_ERR_MEMORY;
-                }
-                entries = temp_entries;
-
-                snprintf(entries[entry_count].name, sizeof(entries[entry_count].name), "%s/%s", path, entry->d_name); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
-                if (snprintf(entries[entry_count].name, sizeof(entries[entry_count].name), "%s/%s", path, entry->d_name) >= sizeof(entries[entry_count].name)) { // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
-                    fprintf(stderr, "Filename too long: %s/%s\n", path, entry->d_name);
-                    continue;
-                }
-
-                if (args->dereference) {
-                    if (stat(entries[entry_count].name, &entries[entry_count].statbuf) != 0) {
-                        fprintf(stderr, "Error retrieving info for %s\n", entries[entry_count].name);
-                        continue;
-                    }
-                } else {
-                    if (lstat(entries[entry_count].name, &entries[entry_count].statbuf) != 0) {
-                        fprintf(stderr, "Error retrieving info for %s\n", entries[entry_count].name);
-                        continue;
-                    }
-                }
-                entry_count++;
-            }
-            closedir(dir);
-
-            if (args->sort == SORT_TIME) {
-                if (entries != NULL) {
-                    qsort(entries, entry_count, sizeof(FileEntry), CompareByTime);
-                }
-            } else if (args->sort == SORT_SIZE) {
-                if (entries != NULL) {
-                    qsort(entries, entry_count, sizeof(FileEntry), CompareBySize);
-                }
-            } else {
-                if (entries != NULL) {
-                    qsort(entries, entry_count, sizeof(FileEntry), CompareByName);
-                }
-            }
+// Текстовый листинг строится поверх посетителя библиотечного интерфейса
+ListErrorCode ListPaths(const GenericVector* paths, const ListArgs* args, FILE* out) {
+    if (args->watch) return WatchPaths(paths, args, out);
+    // Каждая директория -R заново считала бы все свое поддерево
+    if (args->du && args->recursive) {
+        fprintf(stderr, "--du cannot be combined with -R\n");
+        return LIST_ERR_INVALID_ARG;
+    }
 
-            if (args->reverse) {
-                for (size_t j = 0; j < entry_count / 2; j++) {
-                    FileEntry temp = entries[j];
-                    entries[j] = entries[entry_count - j - 1];
-                    entries[entry_count - j - 1] = temp;
-                }
-            }
+    OutBuf ob;
+    if (!InitOutBuf(&ob, out)) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
+    }
+    StatEngines engines;
+    InitStatEngines(&engines, args);
+
+    // Цвет для директорий используется только при выводе в терминальные потоки
+    bool color = (out == stdout) || (out == stderr);
+    TextRenderer renderer;
+    ListVisitor visitor;
+    InitTextRenderer(&renderer, &visitor, args, &ob, color);
+    EntryStore store;
+    InitEntryStore(&store);
+    bool printed_tree = false;
+
+    ListErrorCode result = LIST_SUCCESS;
+    for (size_t i = 0; result == LIST_SUCCESS && i < GetLength(paths); i++) {
+        result = ListPath((char*)GetElement(paths, i), args, &ob, color, &engines, &visitor, &store, &printed_tree);
+    }
 
-            int total = 0;
-            for (size_t j = 0; j < entry_count; j++) {
-                const struct stat *entry_stat = &entries[j].statbuf;
-                total += entry_stat->st_blocks;
-            }
+    FreeEntryStore(&store);
+    FreeTextRenderer(&renderer);
+    FreeOutBuf(&ob);
+    FreeStatEngines(&engines);
+    return result;
+}
 
-            char total_buf[16];
-            if (args->longFormat) {
-                if (args->humanReadable || args->si) {
-                    FormatSize(total_buf, sizeof(total_buf), total*512, args->humanReadable, args->si);
-                    fprintf(out, "total %s\n", args->humanReadable || args->si ? total_buf : "");
-                } else {
-                    fprintf(out, "total %d\n", total/2);
-                }
-            }
 
-            for (size_t j = 0; j < entry_count; j++) {
-                struct stat *entry_stat = &entries[j].statbuf;
-                ColumnWidths widths;
-                CalculateMaxWidths(entries, entry_count, &widths, args);
-                if (args->size && !args->longFormat) {
-                    PrintLongFormat(out, entries[j].name, entry_stat, args, &widths);
-                } else {
-                    if (args->longFormat) {
-                        PrintLongFormat(out, entries[j].name, entry_stat, args, &widths);
-                    } else {
-                        fprintf(out, "%s\n", basename(entries[j].name));
-                    }
-                }
-            }
-            free(entries);
-        } else {
-            fprintf(out, "%s\n", path);
-        }
-    }
-    return LIST_SUCCESS;
-}
\ No newline at end of file
+ListErrorCode ListPathsWithStats(const GenericVector* paths, const ListArgs* args, FILE* out, ListStats *stats) {
+    if (!stats) return ListPaths(paths, args, out);
+    StartStats();
+    ListErrorCode result = ListPaths(paths, args, out);
+    StopStats(stats);
+    return result;
+}
@@ -4,6 +4,8 @@
 #include <stdbool.h>
 
 #include "vector.h"
+#include "timefmt.h"
+#include "stats.h"
 
 typedef struct ListArgs {
     bool all;
@@ -16,11 +18,28 @@ typedef struct ListArgs {
     bool size;
     bool reverse;     
     bool longFormat;
+    bool recursive;
+    bool debug;       // Вывод отладочных счетчиков в stderr
+    int jobs;         // Число потоков для получения метаданных (--jobs N)
+    bool ioUring;     // Пакетный statx через io_uring (--io-uring)
     enum {
-        SORT_NONE,
+        SORT_NONE,    // Порядок директории, вывод потоком (-U, -f)
         SORT_SIZE,
         SORT_TIME,
+        SORT_NAME,    // По умолчанию
     } sort;
+    TimeStyle timeStyle;     // Формат времени в -l (--time-style)
+    const char *timeFormat;  // Формат strftime для --time-style +FORMAT
+    bool stats;              // Время по фазам и счетчики в stderr (--stats)
+    enum {
+        FORMAT_TEXT,  // Вывод в стиле ls, по умолчанию
+        FORMAT_JSONL, // Запись JSON на строку (--format=jsonl)
+        FORMAT_NUL,   // Поля, завершенные '\0' (--format=nul)
+    } format;
+    const char *cacheDir;    // Каталог снимков директорий (--cache DIR), NULL - без кэша
+    bool watch;              // Слежение за директориями через inotify после листинга (--watch)
+    bool du;                 // Блоки поддиректорий - все поддерево, без повторов жестких ссылок (--du)
+    size_t top;              // Только первые N записей каждой директории (--top N), 0 - все
 } ListArgs;
 
 typedef enum ListErrorCode {
@@ -43,4 +62,12 @@ typedef enum ListErrorCode {
 *  - qsort
 */
 ListErrorCode ListPaths(const GenericVector* paths, const ListArgs* args, FILE* out);
+// ListPaths with per-phase timing and counters collected into stats (when not NULL)
+ListErrorCode ListPathsWithStats(const GenericVector* paths, const ListArgs* args, FILE* out, ListStats *stats);
 void ExpandPathsWithGlob(GenericVector *paths);
+
+// Buffer size for FormatSize
+#define HUMAN_SIZE_MAX 16
+// Size as printed by -h (powers of 1024) or --si (powers of 1000), rounded up like GNU ls
+// buf must hold HUMAN_SIZE_MAX bytes; returns the length
+size_t FormatSize(char *buf, unsigned long long size, bool si);
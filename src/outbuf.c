@@ -0,0 +1,153 @@
+#include "outbuf.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+#define OUT_BUF_SIZE (64 * 1024)
+
+// Строки прав "rwxrwxrwx" для всех 512 комбинаций младших битов st_mode
+static char mode_table[512][9];
+static pthread_once_t mode_table_once = PTHREAD_ONCE_INIT;
+
+static void BuildModeTable(void) {
+    static const char letters[] = "rwxrwxrwx";
+    for (int mode = 0; mode < 512; mode++) {
+        for (int bit = 0; bit < 9; bit++) {
+            mode_table[mode][bit] = (mode & (0400 >> bit)) ? letters[bit] : '-';
+        }
+    }
+}
+
+bool InitOutBuf(OutBuf *ob, FILE *stream) {
+    ob->data = malloc(OUT_BUF_SIZE);
+    if (!ob->data) return false;
+    ob->len = 0;
+    ob->capacity = OUT_BUF_SIZE;
+    ob->stream = stream;
+    ob->failed = false;
+
+    // Дальше запись идет мимо stdio, поэтому накопленное в потоке выводится первым
+    fflush(stream);
+    ob->fd = fileno(stream);
+    pthread_once(&mode_table_once, BuildModeTable);
+    return true;
+}
+
+// Запись вектора целиком с учетом частичных записей
+// В памятные потоки (fd < 0) запись идет через fwrite и в счетчики вывода не попадает
+static void WriteAll(OutBuf *ob, struct iovec *iov, int iovcnt) {
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_OUTPUT);
+    if (ob->fd < 0) {
+        for (int i = 0; i < iovcnt; i++) {
+            if (fwrite(iov[i].iov_base, 1, iov[i].iov_len, ob->stream) != iov[i].iov_len) {
+                ob->failed = true;
+            }
+        }
+        LeaveStatsPhase(previous);
+        return;
+    }
+
+    while (iovcnt > 0 && !ob->failed) {
+        ssize_t written = writev(ob->fd, iov, iovcnt);
+        CountStats(STATS_WRITES, 1);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            ob->failed = true;
+            break;
+        }
+        CountStats(STATS_BYTES_WRITTEN, (unsigned long long)written);
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
+    LeaveStatsPhase(previous);
+}
+
+void FlushOutBuf(OutBuf *ob) {
+    if (ob->len > 0) {
+        struct iovec iov = {ob->data, ob->len};
+        WriteAll(ob, &iov, 1);
+        ob->len = 0;
+    }
+}
+
+void FreeOutBuf(OutBuf *ob) {
+    FlushOutBuf(ob);
+    free(ob->data);
+    ob->data = NULL;
+}
+
+void OutWrite(OutBuf *ob, const char *bytes, size_t len) {
+    if (len <= ob->capacity - ob->len) {
+        memcpy(ob->data + ob->len, bytes, len);
+        ob->len += len;
+        return;
+    }
+    if (len < ob->capacity) {
+        FlushOutBuf(ob);
+        memcpy(ob->data, bytes, len);
+        ob->len = len;
+        return;
+    }
+
+    // Крупный блок уходит одним writev вместе с накопленным буфером
+    struct iovec iov[2] = {{ob->data, ob->len}, {(void *)bytes, len}};
+    WriteAll(ob, iov, 2);
+    ob->len = 0;
+}
+
+static void OutSpaces(OutBuf *ob, size_t count) {
+    static const char spaces[] = "                                ";
+    while (count > 0) {
+        size_t chunk = (count < sizeof(spaces) - 1) ? count : sizeof(spaces) - 1;
+        OutWrite(ob, spaces, chunk);
+        count -= chunk;
+    }
+}
+
+void OutPadLeft(OutBuf *ob, const char *str, size_t width) {
+    size_t len = strlen(str);
+    if (len < width) OutSpaces(ob, width - len);
+    OutWrite(ob, str, len);
+}
+
+void OutPadRight(OutBuf *ob, const char *str, size_t width) {
+    size_t len = strlen(str);
+    OutWrite(ob, str, len);
+    if (len < width) OutSpaces(ob, width - len);
+}
+
+size_t FormatUnsigned(char *buf, unsigned long long value) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    for (size_t i = 0; i < count; i++) {
+        buf[i] = digits[count - i - 1];
+    }
+    buf[count] = '\0';
+    return count;
+}
+
+void OutUnsigned(OutBuf *ob, unsigned long long value) {
+    char buf[21];
+    OutWrite(ob, buf, FormatUnsigned(buf, value));
+}
+
+void OutModeBits(OutBuf *ob, mode_t mode) {
+    OutWrite(ob, mode_table[mode & 0777], 9);
+}
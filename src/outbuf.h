@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+// Output stage: lines are rendered into a reusable byte buffer which is
+// flushed with large write/writev calls on the descriptor behind the stream
+// (streams without a descriptor, e.g. memory streams, get fwrite instead)
+typedef struct OutBuf {
+    char *data;
+    size_t len;
+    size_t capacity;
+    FILE *stream;
+    int fd;
+    bool failed;
+} OutBuf;
+
+// Attach a buffer to the stream; pending stdio output of the stream is flushed first
+// Returns false if memory allocation failed
+bool InitOutBuf(OutBuf *ob, FILE *stream);
+// Flush the buffer and free it
+void FreeOutBuf(OutBuf *ob);
+// Write out everything buffered so far
+void FlushOutBuf(OutBuf *ob);
+
+// Append bytes, bypassing the buffer for payloads larger than it
+void OutWrite(OutBuf *ob, const char *bytes, size_t len);
+// Append a string padded with spaces on the left (right-aligned) or on the right
+void OutPadLeft(OutBuf *ob, const char *str, size_t width);
+void OutPadRight(OutBuf *ob, const char *str, size_t width);
+// Append a decimal number
+void OutUnsigned(OutBuf *ob, unsigned long long value);
+// Append "rwxr-xr-x"-style permission bits of the mode via a 512-entry table
+void OutModeBits(OutBuf *ob, mode_t mode);
+
+// Render a decimal number into buf (at least 21 bytes), returns its length
+size_t FormatUnsigned(char *buf, unsigned long long value);
+
+// Append a string literal without strlen
+#define OUT_LITERAL(ob, lit) OutWrite((ob), (lit), sizeof(lit) - 1)
+
+static inline void OutChar(OutBuf *ob, char c) {
+    if (ob->len == ob->capacity) FlushOutBuf(ob);
+    ob->data[ob->len++] = c;
+}
+
+static inline void OutStr(OutBuf *ob, const char *str) {
+    OutWrite(ob, str, strlen(str));
+}
@@ -0,0 +1,164 @@
+#include "records.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+// Проверка UTF-8 по RFC 3629: без избыточных кодировок, суррогатов и значений выше U+10FFFF
+bool IsValidUtf8(const char *str, size_t len) {
+    const unsigned char *p = (const unsigned char *)str;
+    size_t i = 0;
+    while (i < len) {
+        unsigned char c = p[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+        size_t extra;
+        unsigned char min = 0x80, max = 0xbf;  // Допустимый диапазон второго байта
+        if (c >= 0xc2 && c <= 0xdf) {
+            extra = 1;
+        } else if (c >= 0xe0 && c <= 0xef) {
+            extra = 2;
+            if (c == 0xe0) min = 0xa0;
+            if (c == 0xed) max = 0x9f;
+        } else if (c >= 0xf0 && c <= 0xf4) {
+            extra = 3;
+            if (c == 0xf0) min = 0x90;
+            if (c == 0xf4) max = 0x8f;
+        } else {
+            return false;
+        }
+        if (len - i <= extra || p[i + 1] < min || p[i + 1] > max) return false;
+        for (size_t k = 2; k <= extra; k++) {
+            if ((p[i + k] & 0xc0) != 0x80) return false;
+        }
+        i += extra + 1;
+    }
+    return true;
+}
+
+// Строка JSON: экранируются кавычки, обратная косая черта и управляющие символы
+// С bytes каждый байт от 0x80 выводится как \u00XX, то есть строка передается
+// побайтно (код символа = байт) - так выводятся имена, не являющиеся UTF-8
+static void OutJsonString(OutBuf *ob, const char *str, size_t len, bool bytes) {
+    static const char hex[] = "0123456789abcdef";
+    OutChar(ob, '"');
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)str[i];
+        if (c >= 0x20 && c != '"' && c != '\\' && (c < 0x80 || !bytes)) continue;
+        // Обычные символы выводятся кусками между экранируемыми
+        OutWrite(ob, str + start, i - start);
+        start = i + 1;
+        switch (c) {
+            case '"': OUT_LITERAL(ob, "\\\""); break;
+            case '\\': OUT_LITERAL(ob, "\\\\"); break;
+            case '\n': OUT_LITERAL(ob, "\\n"); break;
+            case '\t': OUT_LITERAL(ob, "\\t"); break;
+            case '\r': OUT_LITERAL(ob, "\\r"); break;
+            default: {
+                char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+                OutWrite(ob, escape, sizeof(escape));
+                break;
+            }
+        }
+    }
+    OutWrite(ob, str + start, len - start);
+    OutChar(ob, '"');
+}
+
+static void OutSigned(OutBuf *ob, long long value) {
+    if (value < 0) {
+        OutChar(ob, '-');
+        OutUnsigned(ob, -(unsigned long long)value);
+    } else {
+        OutUnsigned(ob, (unsigned long long)value);
+    }
+}
+
+static long long MtimeNs(const struct stat *st) {
+    return (long long)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+// Строковое поле; не-UTF-8 значение выводится побайтно и помечается полем "<name>_escaped":true
+static void OutJsonStringField(OutBuf *ob, const char *name, size_t name_len, const char *str, size_t len) {
+    bool bytes = !IsValidUtf8(str, len);
+    OutChar(ob, '"');
+    OutWrite(ob, name, name_len);
+    OUT_LITERAL(ob, "\":");
+    OutJsonString(ob, str, len, bytes);
+    if (bytes) {
+        OUT_LITERAL(ob, ",\"");
+        OutWrite(ob, name, name_len);
+        OUT_LITERAL(ob, "_escaped\":true");
+    }
+}
+
+static void OutJsonRecord(OutBuf *ob, const char *event, const char *path, const struct stat *st, const char *target,
+                          size_t target_len) {
+    OutChar(ob, '{');
+    if (event) {
+        OUT_LITERAL(ob, "\"event\":\"");
+        OutStr(ob, event);
+        OUT_LITERAL(ob, "\",");
+    }
+    OutJsonStringField(ob, "path", 4, path, strlen(path));
+    OUT_LITERAL(ob, ",\"mode\":");
+    OutUnsigned(ob, st->st_mode);
+    OUT_LITERAL(ob, ",\"nlink\":");
+    OutUnsigned(ob, st->st_nlink);
+    OUT_LITERAL(ob, ",\"uid\":");
+    OutUnsigned(ob, st->st_uid);
+    OUT_LITERAL(ob, ",\"gid\":");
+    OutUnsigned(ob, st->st_gid);
+    OUT_LITERAL(ob, ",\"size\":");
+    OutSigned(ob, st->st_size);
+    OUT_LITERAL(ob, ",\"blocks\":");
+    OutSigned(ob, st->st_blocks);
+    OUT_LITERAL(ob, ",\"mtime_ns\":");
+    OutSigned(ob, MtimeNs(st));
+    if (target) {
+        OutChar(ob, ',');
+        OutJsonStringField(ob, "target", 6, target, target_len);
+    }
+    OUT_LITERAL(ob, "}\n");
+}
+
+static void OutNulRecord(OutBuf *ob, const char *event, const char *path, const struct stat *st, const char *target,
+                         size_t target_len) {
+    if (event) {
+        OutStr(ob, event);
+        OutChar(ob, '\0');
+    }
+    OutStr(ob, path);
+    OutChar(ob, '\0');
+    OutUnsigned(ob, st->st_mode);
+    OutChar(ob, '\0');
+    OutUnsigned(ob, st->st_nlink);
+    OutChar(ob, '\0');
+    OutUnsigned(ob, st->st_uid);
+    OutChar(ob, '\0');
+    OutUnsigned(ob, st->st_gid);
+    OutChar(ob, '\0');
+    OutSigned(ob, st->st_size);
+    OutChar(ob, '\0');
+    OutSigned(ob, st->st_blocks);
+    OutChar(ob, '\0');
+    OutSigned(ob, MtimeNs(st));
+    OutChar(ob, '\0');
+    if (target) OutWrite(ob, target, target_len);
+    OutChar(ob, '\0');
+}
+
+void OutRecord(OutBuf *ob, const ListArgs *args, const char *path, const struct stat *st, const char *target, size_t target_len) {
+    OutEventRecord(ob, args, NULL, path, st, target, target_len);
+}
+
+void OutEventRecord(OutBuf *ob, const ListArgs *args, const char *event, const char *path, const struct stat *st,
+                    const char *target, size_t target_len) {
+    if (args->format == FORMAT_JSONL) {
+        OutJsonRecord(ob, event, path, st, target, target_len);
+    } else {
+        OutNulRecord(ob, event, path, st, target, target_len);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <sys/stat.h>
+
+#include "ls.h"
+#include "outbuf.h"
+
+// Machine-readable records (--format=jsonl, --format=nul): one record per entry
+// with raw numeric fields, without column widths, colour or a total line
+//
+// jsonl: {"path":"...","mode":N,"nlink":N,"uid":N,"gid":N,"size":N,"blocks":N,"mtime_ns":N,"target":"..."}\n
+//   "target" is present only for symbolic links; path and target are JSON-escaped
+//   A path or target that is not valid UTF-8 is written byte by byte: every byte from 0x80
+//   becomes \u00XX, and "path_escaped":true (or "target_escaped":true) follows the field,
+//   so the original bytes are the code points of the decoded string
+// nul: the same nine fields in the same order, each terminated by '\0'
+//   (target is empty for non-links), so a record is always nine fields
+// Whether the bytes are valid UTF-8 (RFC 3629: no overlong forms, surrogates or code points above U+10FFFF)
+bool IsValidUtf8(const char *str, size_t len);
+
+void OutRecord(OutBuf *ob, const ListArgs *args, const char *path, const struct stat *st, const char *target, size_t target_len);
+
+// A record of a change reported by --watch: event ("added", "removed", "changed") comes
+// first, as "event":"..." in jsonl and as an extra leading field in nul (ten fields)
+void OutEventRecord(OutBuf *ob, const ListArgs *args, const char *event, const char *path, const struct stat *st,
+                    const char *target, size_t target_len);
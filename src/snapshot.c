@@ -0,0 +1,225 @@
+#include "snapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+#define SNAPSHOT_MAGIC 0x3150414e53325748ULL  // "HW2SNAP1"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_DEREFERENCE 1u
+
+// Файл: заголовок, записи фиксированного размера, затем строки (имена и цели ссылок,
+// каждая завершена '\0'). Формат зависит от платформы: файл читает та же сборка, что писала
+typedef struct SnapshotHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_size;  // Меняется вместе с struct stat
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t ctime_sec;
+    int64_t ctime_nsec;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t strings_size;
+} SnapshotHeader;
+
+typedef struct SnapshotRecord {
+    uint64_t name_off;
+    uint64_t target_off;   // UINT64_MAX - цели нет
+    uint32_t name_len;
+    uint32_t target_len;
+    uint32_t type;
+    uint32_t reserved;
+    struct stat statbuf;
+} SnapshotRecord;
+
+// Счетчик для уникальных имен временных файлов внутри процесса
+static unsigned int temp_counter;
+
+static bool SnapshotPath(char *buf, size_t size, const char *cache_dir, const struct stat *dir_stat, bool dereference) {
+    int len = snprintf(buf, size, "%s/%llx-%llx%s.snap", cache_dir, (unsigned long long)dir_stat->st_dev,
+                       (unsigned long long)dir_stat->st_ino, dereference ? "-L" : "");
+    return len > 0 && (size_t)len < size;
+}
+
+static void FillHeaderKey(SnapshotHeader *header, const struct stat *dir_stat, bool dereference) {
+    header->magic = SNAPSHOT_MAGIC;
+    header->version = SNAPSHOT_VERSION;
+    header->record_size = sizeof(SnapshotRecord);
+    header->dev = dir_stat->st_dev;
+    header->ino = dir_stat->st_ino;
+    header->mtime_sec = dir_stat->st_mtim.tv_sec;
+    header->mtime_nsec = dir_stat->st_mtim.tv_nsec;
+    header->ctime_sec = dir_stat->st_ctim.tv_sec;
+    header->ctime_nsec = dir_stat->st_ctim.tv_nsec;
+    header->flags = dereference ? SNAPSHOT_DEREFERENCE : 0;
+    header->reserved = 0;
+}
+
+// Строка [off, off + len) лежит в области строк и завершена '\0'
+static bool ValidString(const char *strings, uint64_t strings_size, uint64_t off, uint64_t len) {
+    return off < strings_size && len < strings_size - off && strings[off + len] == '\0';
+}
+
+bool LoadSnapshot(const char *cache_dir, const struct stat *dir_stat, bool dereference, Snapshot *snapshot) {
+    char path[PATH_MAX];
+    if (!SnapshotPath(path, sizeof(path), cache_dir, dir_stat, dereference)) return false;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)file_stat.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    // Ключ сравнивается целиком: любое изменение директории делает снимок устаревшим
+    const SnapshotHeader *header = map;
+    SnapshotHeader expected;
+    FillHeaderKey(&expected, dir_stat, dereference);
+    size_t body = size - sizeof(SnapshotHeader);
+    bool valid = header->magic == expected.magic && header->version == expected.version &&
+                 header->record_size == expected.record_size && header->dev == expected.dev && header->ino == expected.ino &&
+                 header->mtime_sec == expected.mtime_sec && header->mtime_nsec == expected.mtime_nsec &&
+                 header->ctime_sec == expected.ctime_sec && header->ctime_nsec == expected.ctime_nsec &&
+                 header->flags == expected.flags && header->count <= body / sizeof(SnapshotRecord) &&
+                 header->strings_size == body - header->count * sizeof(SnapshotRecord);
+    FileEntry *entries = valid ? malloc((header->count ? header->count : 1) * sizeof(FileEntry)) : NULL;
+    if (!entries) {
+        munmap(map, size);
+        return false;
+    }
+
+    // Записи становятся представлениями прямо в отображение, без копирования строк
+    const SnapshotRecord *records = (const SnapshotRecord *)(header + 1);
+    const char *strings = (const char *)(records + header->count);
+    for (size_t i = 0; i < header->count; i++) {
+        const SnapshotRecord *record = &records[i];
+        bool has_target = (record->target_off != UINT64_MAX);
+        if (!ValidString(strings, header->strings_size, record->name_off, record->name_len) || record->name_len == 0 ||
+            (has_target && !ValidString(strings, header->strings_size, record->target_off, record->target_len))) {
+            free(entries);
+            munmap(map, size);
+            return false;
+        }
+        FileEntry *entry = &entries[i];
+        entry->name = strings + record->name_off;
+        entry->name_len = record->name_len;
+        entry->type = (unsigned char)record->type;
+        entry->target = has_target ? strings + record->target_off : NULL;
+        entry->target_len = has_target ? record->target_len : 0;
+        entry->statbuf = record->statbuf;
+    }
+
+    snapshot->map = map;
+    snapshot->map_size = size;
+    snapshot->entries = entries;
+    snapshot->count = header->count;
+    CountStats(STATS_SNAPSHOT_HITS, 1);
+    return true;
+}
+
+void FreeSnapshot(Snapshot *snapshot) {
+    free(snapshot->entries);
+    if (snapshot->map) munmap(snapshot->map, snapshot->map_size);
+    snapshot->map = NULL;
+    snapshot->entries = NULL;
+    snapshot->count = 0;
+}
+
+static bool WriteAllBytes(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        len -= (size_t)written;
+    }
+    return true;
+}
+
+void SaveSnapshot(const char *cache_dir, const struct stat *dir_stat, bool dereference, const FileEntry *entries, size_t count) {
+    // Директория, измененная в пределах последней секунды, может измениться еще раз с тем же
+    // временем изменения (грубые метки времени ФС), и такой снимок нельзя было бы отличить от
+    // устаревшего: она кэшируется при следующем листинге
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (dir_stat->st_ctim.tv_sec >= now.tv_sec - 1 || dir_stat->st_mtim.tv_sec >= now.tv_sec - 1) return;
+
+    char path[PATH_MAX];
+    char temp_path[PATH_MAX];
+    unsigned int serial = __atomic_fetch_add(&temp_counter, 1, __ATOMIC_RELAXED);
+    if (!SnapshotPath(path, sizeof(path), cache_dir, dir_stat, dereference)) return;
+    int len = snprintf(temp_path, sizeof(temp_path), "%s.%d.%u.tmp", path, (int)getpid(), serial);
+    if (len < 0 || (size_t)len >= sizeof(temp_path)) return;
+
+    uint64_t strings_size = 0;
+    for (size_t i = 0; i < count; i++) {
+        strings_size += entries[i].name_len + 1;
+        if (entries[i].target) strings_size += entries[i].target_len + 1;
+    }
+    size_t size = sizeof(SnapshotHeader) + count * sizeof(SnapshotRecord) + strings_size;
+    char *data = calloc(1, size);
+    if (!data) return;
+
+    SnapshotHeader *header = (SnapshotHeader *)data;
+    FillHeaderKey(header, dir_stat, dereference);
+    header->count = count;
+    header->strings_size = strings_size;
+    SnapshotRecord *records = (SnapshotRecord *)(header + 1);
+    char *strings = (char *)(records + count);
+    uint64_t off = 0;
+    for (size_t i = 0; i < count; i++) {
+        const FileEntry *entry = &entries[i];
+        SnapshotRecord *record = &records[i];
+        record->name_off = off;
+        record->name_len = entry->name_len;
+        memcpy(strings + off, entry->name, entry->name_len);
+        off += entry->name_len + 1;
+        record->target_off = UINT64_MAX;
+        if (entry->target) {
+            record->target_off = off;
+            record->target_len = entry->target_len;
+            memcpy(strings + off, entry->target, entry->target_len);
+            off += entry->target_len + 1;
+        }
+        record->type = entry->type;
+        record->statbuf = entry->statbuf;
+    }
+
+    // Снимок пишется во временный файл и подменяется переименованием:
+    // читатели видят либо старый файл целиком, либо новый
+    if (mkdir(cache_dir, 0700) != 0 && errno != EEXIST) {
+        free(data);
+        return;
+    }
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        free(data);
+        return;
+    }
+    bool ok = WriteAllBytes(fd, data, size);
+    ok = (close(fd) == 0) && ok;
+    if (!ok || rename(temp_path, path) != 0) {
+        unlink(temp_path);
+    }
+    free(data);
+}
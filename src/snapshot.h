@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+#include "entry_store.h"
+
+// On-disk snapshots of directory listings (--cache): one memory-mapped file per
+// directory holding all of its entries in directory order with stat data and link targets
+// A snapshot is keyed by the device and inode of the directory and is valid only while
+// the directory mtime and ctime are unchanged; anything else (a different key, a malformed
+// or truncated file) is a miss. Changes that do not touch the directory itself, such as
+// a file growing in place, are not seen until the directory changes (".." is re-read)
+typedef struct Snapshot {
+    void *map;
+    size_t map_size;
+    FileEntry *entries;  // Views into the mapping, owned by the snapshot
+    size_t count;
+} Snapshot;
+
+// Map the snapshot of the directory described by dir_stat (stat data of entries
+// follows links when dereference is set). Returns false on a miss
+bool LoadSnapshot(const char *cache_dir, const struct stat *dir_stat, bool dereference, Snapshot *snapshot);
+// Unmap the snapshot and free the entry views
+void FreeSnapshot(Snapshot *snapshot);
+
+// Store the entries as the snapshot of the directory; dir_stat is the stat taken before
+// the directory was read. The file is replaced atomically; failures only skip caching
+void SaveSnapshot(const char *cache_dir, const struct stat *dir_stat, bool dereference, const FileEntry *entries, size_t count);
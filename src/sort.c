@@ -0,0 +1,241 @@
+#include "sort.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TOP_HEAP_MIN_CAPACITY 64
+
+typedef struct SortItem {
+    uint64_t key;
+    const FileEntry *entry;
+} SortItem;
+
+// Сортировка по имени с учетом регистра
+int CompareEntryNames(const void *a, const void *b) {
+    const FileEntry *entryA = *(const FileEntry *const *)a;
+    const FileEntry *entryB = *(const FileEntry *const *)b;
+    return strcmp(entryA->name, entryB->name);
+}
+
+int CompareItemNames(const void *a, const void *b) {
+    return strcmp(((const SortItem *)a)->entry->name, ((const SortItem *)b)->entry->name);
+}
+
+// Ключ по убыванию: знаковое значение сдвигается в беззнаковый диапазон и инвертируется
+uint64_t DescendingKey(int64_t value) {
+    return ~((uint64_t)value ^ (UINT64_C(1) << 63));
+}
+
+// LSD radix sort по байтам ключа; байты, одинаковые у всех элементов, пропускаются
+// Возвращает массив с результатом (items или tmp)
+SortItem *RadixSort(SortItem *items, SortItem *tmp, size_t count) {
+    size_t histogram[8][256];
+    memset(histogram, 0, sizeof(histogram));
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = items[i].key;
+        for (int byte = 0; byte < 8; byte++) {
+            histogram[byte][(key >> (byte * 8)) & 0xff]++;
+        }
+    }
+
+    for (int byte = 0; byte < 8; byte++) {
+        size_t *counts = histogram[byte];
+        if (counts[(items[0].key >> (byte * 8)) & 0xff] == count) continue;
+
+        size_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            size_t digit_count = counts[digit];
+            counts[digit] = offset;
+            offset += digit_count;
+        }
+        for (size_t i = 0; i < count; i++) {
+            tmp[counts[(items[i].key >> (byte * 8)) & 0xff]++] = items[i];
+        }
+        SortItem *swap = items;
+        items = tmp;
+        tmp = swap;
+    }
+    return items;
+}
+
+int CompareOutputOrder(const FileEntry *a, const FileEntry *b, const ListArgs *args) {
+    if (args->sort == SORT_NONE) return 0;
+    int result;
+    if (args->sort == SORT_SIZE || args->sort == SORT_TIME) {
+        // Те же ключи, что и в радиксной сортировке SortEntries
+        const struct stat *sa = &a->statbuf;
+        const struct stat *sb = &b->statbuf;
+        int64_t ka = args->sort == SORT_TIME ? (int64_t)sa->st_mtime : (args->du ? (int64_t)sa->st_blocks : (int64_t)sa->st_size);
+        int64_t kb = args->sort == SORT_TIME ? (int64_t)sb->st_mtime : (args->du ? (int64_t)sb->st_blocks : (int64_t)sb->st_size);
+        result = (ka != kb) ? (ka > kb ? -1 : 1) : strcmp(a->name, b->name);
+    } else {
+        result = strcmp(a->name, b->name);
+    }
+    return args->reverse ? -result : result;
+}
+
+
+const FileEntry **SortEntries(const FileEntry *entries, size_t count, const ListArgs *args) {
+    const FileEntry **order = malloc((count ? count : 1) * sizeof(FileEntry *));
+    if (!order) return NULL;
+
+    if (args->sort == SORT_NONE) {
+        // Порядок директории; -r без сортировки ни на что не влияет
+        for (size_t i = 0; i < count; i++) {
+            order[i] = &entries[i];
+        }
+        return order;
+    }
+
+    if (args->sort != SORT_SIZE && args->sort != SORT_TIME) {
+        for (size_t i = 0; i < count; i++) {
+            order[i] = &entries[i];
+        }
+        qsort(order, count, sizeof(FileEntry *), CompareEntryNames);
+    } else if (count > 0) {
+        SortItem *items = malloc(count * sizeof(SortItem));
+        SortItem *tmp = malloc(count * sizeof(SortItem));
+        if (!items || !tmp) {
+            free(items);
+            free(tmp);
+            free(order);
+            return NULL;
+        }
+
+        // Сравнение ключей целиком, без усечения разности off_t/time_t до int
+        // С --du размер - занятые блоки поддерева
+        for (size_t i = 0; i < count; i++) {
+            const struct stat *st = &entries[i].statbuf;
+            int64_t size = args->du ? (int64_t)st->st_blocks : (int64_t)st->st_size;
+            items[i].key = DescendingKey(args->sort == SORT_SIZE ? size : (int64_t)st->st_mtime);
+            items[i].entry = &entries[i];
+        }
+        SortItem *sorted = RadixSort(items, tmp, count);
+
+        // Группы с равным ключом упорядочиваются по имени
+        for (size_t begin = 0; begin < count;) {
+            size_t end = begin + 1;
+            while (end < count && sorted[end].key == sorted[begin].key) end++;
+            if (end - begin > 1) {
+                qsort(sorted + begin, end - begin, sizeof(SortItem), CompareItemNames);
+            }
+            for (size_t i = begin; i < end; i++) {
+                order[i] = sorted[i].entry;
+            }
+            begin = end;
+        }
+        free(items);
+        free(tmp);
+    }
+
+    // -r разворачивает готовый порядок, сами записи не перемещаются
+    if (args->reverse) {
+        for (size_t i = 0; i < count / 2; i++) {
+            const FileEntry *swap = order[i];
+            order[i] = order[count - i - 1];
+            order[count - i - 1] = swap;
+        }
+    }
+    return order;
+}
+
+
+bool InitTopHeap(TopHeap *heap, size_t limit, const ListArgs *args) {
+    heap->capacity = (limit < TOP_HEAP_MIN_CAPACITY) ? limit : TOP_HEAP_MIN_CAPACITY;
+    heap->entries = malloc((heap->capacity ? heap->capacity : 1) * sizeof(FileEntry));
+    heap->count = 0;
+    heap->limit = limit;
+    heap->args = args;
+    return heap->entries != NULL;
+}
+
+
+static void FreeEntryCopy(FileEntry *entry) {
+    free((char *)entry->name);
+    free((char *)entry->target);
+}
+
+
+void FreeTopHeap(TopHeap *heap) {
+    for (size_t i = 0; i < heap->count; i++) {
+        FreeEntryCopy(&heap->entries[i]);
+    }
+    free(heap->entries);
+    heap->entries = NULL;
+    heap->count = 0;
+}
+
+
+// Копия записи, не зависящая от хранилища окна
+static bool CopyEntry(FileEntry *copy, const FileEntry *entry) {
+    *copy = *entry;
+    copy->name = strndup(entry->name, entry->name_len);
+    copy->target = entry->target ? strndup(entry->target, entry->target_len) : NULL;
+    if (!copy->name || (entry->target && !copy->target)) {
+        FreeEntryCopy(copy);
+        return false;
+    }
+    return true;
+}
+
+
+static void SwapEntries(FileEntry *a, FileEntry *b) {
+    FileEntry swap = *a;
+    *a = *b;
+    *b = swap;
+}
+
+
+// В корне - запись, выводимая последней из оставленных
+static void SiftUp(TopHeap *heap, size_t idx) {
+    while (idx > 0) {
+        size_t parent = (idx - 1) / 2;
+        if (CompareOutputOrder(&heap->entries[parent], &heap->entries[idx], heap->args) >= 0) break;
+        SwapEntries(&heap->entries[parent], &heap->entries[idx]);
+        idx = parent;
+    }
+}
+
+
+static void SiftDown(TopHeap *heap, size_t idx) {
+    for (;;) {
+        size_t last = idx;
+        size_t left = idx * 2 + 1;
+        size_t right = left + 1;
+        if (left < heap->count && CompareOutputOrder(&heap->entries[left], &heap->entries[last], heap->args) > 0) last = left;
+        if (right < heap->count && CompareOutputOrder(&heap->entries[right], &heap->entries[last], heap->args) > 0) last = right;
+        if (last == idx) break;
+        SwapEntries(&heap->entries[idx], &heap->entries[last]);
+        idx = last;
+    }
+}
+
+
+bool OfferTopEntry(TopHeap *heap, const FileEntry *entry) {
+    if (heap->count < heap->limit) {
+        if (heap->count == heap->capacity) {
+            size_t new_capacity = (heap->capacity > heap->limit / 2) ? heap->limit : heap->capacity * 2;
+            FileEntry *new_entries = realloc(heap->entries, new_capacity * sizeof(FileEntry));
+            if (!new_entries) return false;
+            heap->entries = new_entries;
+            heap->capacity = new_capacity;
+        }
+        if (!CopyEntry(&heap->entries[heap->count], entry)) return false;
+        SiftUp(heap, heap->count++);
+        return true;
+    }
+    // Запись вытесняет корень, только если выводится раньше него
+    if (heap->limit == 0 || CompareOutputOrder(entry, &heap->entries[0], heap->args) >= 0) return true;
+    FileEntry copy;
+    if (!CopyEntry(&copy, entry)) return false;
+    FreeEntryCopy(&heap->entries[0]);
+    heap->entries[0] = copy;
+    SiftDown(heap, 0);
+    return true;
+}
+
+
+bool TopHeapSettled(const TopHeap *heap) {
+    return heap->args->sort == SORT_NONE && heap->count == heap->limit;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "entry_store.h"
+#include "ls.h"
+
+// Compute the output order of the entries for args->sort and args->reverse
+// without moving the records: returns an array of count pointers into entries
+// (to be freed by the caller) or NULL if memory allocation failed
+// SORT_NONE keeps the directory order and ignores reverse
+// Size and time orders use an LSD radix sort on 64-bit keys, ties are ordered by name
+// With --du the size order is by allocated blocks (the aggregated subtree size)
+const FileEntry **SortEntries(const FileEntry *entries, size_t count, const ListArgs *args);
+
+// Negative if a comes before b in the order of SortEntries (SORT_NONE: always 0)
+int CompareOutputOrder(const FileEntry *a, const FileEntry *b, const ListArgs *args);
+
+// Bounded selection of the first limit entries of the output order (--top N):
+// a max-heap whose root is the last of the kept entries, O(limit) memory and
+// O(log limit) per offered entry. Kept entries own copies of their names and link targets
+typedef struct TopHeap {
+    FileEntry *entries;
+    size_t count;
+    size_t capacity;  // Растет по мере заполнения, но не больше limit
+    size_t limit;
+    const ListArgs *args;
+} TopHeap;
+
+// Returns false if memory allocation failed
+bool InitTopHeap(TopHeap *heap, size_t limit, const ListArgs *args);
+void FreeTopHeap(TopHeap *heap);
+// Keep the entry if it is among the first limit entries seen so far
+// Returns false if memory allocation failed
+bool OfferTopEntry(TopHeap *heap, const FileEntry *entry);
+// Whether nothing offered from now on can be kept (SORT_NONE keeps the first entries read)
+bool TopHeapSettled(const TopHeap *heap);
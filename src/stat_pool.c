@@ -0,0 +1,151 @@
+#include "stat_pool.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "dirscan.h"
+#include "stats.h"
+
+// Записи раздаются потокам порциями, чтобы не дергать общий счетчик на каждой
+#define STAT_CHUNK_SIZE 64
+
+struct StatPool {
+    pthread_t *threads;
+    int thread_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+
+    const StatJob *job;
+    size_t next;           // индекс следующей порции
+    unsigned long generation;
+    int busy;              // потоки, еще работающие над текущим заданием
+    bool stopping;
+};
+
+bool EntryNeedsStat(const StatJob *job, const FileEntry *entry) {
+    mode_t type = entry->statbuf.st_mode & S_IFMT;
+    return job->all_entries || type == 0 || (job->follow_links && S_ISLNK(entry->statbuf.st_mode));
+}
+
+void StatEntryRange(const StatJob *job, size_t begin, size_t end) {
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_STAT);
+    size_t calls = 0;
+    for (size_t i = begin; i < end; i++) {
+        FileEntry *entry = &job->entries[i];
+        job->errors[i] = 0;
+        if (!EntryNeedsStat(job, entry)) continue;
+        calls++;
+        if (StatAt(job->dirfd, entry->name, job->follow_links, job->mask, &entry->statbuf) != 0) {
+            job->errors[i] = errno;
+        }
+    }
+    // Счетчик обновляется один раз на порцию
+    CountStats(STATS_STAT_CALLS, calls);
+    LeaveStatsPhase(previous);
+}
+
+// Забор порций текущего задания, пока они не закончатся
+void ProcessChunks(StatPool *pool, const StatJob *job) {
+    for (;;) {
+        size_t begin = __atomic_fetch_add(&pool->next, STAT_CHUNK_SIZE, __ATOMIC_RELAXED);
+        if (begin >= job->count) break;
+        size_t end = (begin + STAT_CHUNK_SIZE < job->count) ? begin + STAT_CHUNK_SIZE : job->count;
+        StatEntryRange(job, begin, end);
+    }
+}
+
+void *StatWorker(void *arg) {
+    StatPool *pool = arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stopping && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->stopping) break;
+        seen = pool->generation;
+        const StatJob *job = pool->job;
+        pthread_mutex_unlock(&pool->lock);
+
+        ProcessChunks(pool, job);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->work_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+StatPool *NewStatPool(int jobs) {
+    if (jobs < 2) return NULL;
+
+    StatPool *pool = calloc(1, sizeof(StatPool));
+    if (!pool) return NULL;
+    pool->threads = malloc((size_t)(jobs - 1) * sizeof(pthread_t));
+    if (!pool->threads) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    for (int i = 0; i < jobs - 1; i++) {
+        if (pthread_create(&pool->threads[i], NULL, StatWorker, pool) != 0) {
+            FreeStatPool(pool);
+            return NULL;
+        }
+        pool->thread_count++;
+    }
+    return pool;
+}
+
+void FreeStatPool(StatPool *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+    free(pool->threads);
+    free(pool);
+}
+
+void RunStatJob(StatPool *pool, const StatJob *job) {
+    // Мелкие директории быстрее обработать в текущем потоке
+    if (!pool || job->count <= STAT_CHUNK_SIZE) {
+        StatEntryRange(job, 0, job->count);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->job = job;
+    pool->next = 0;
+    pool->busy = pool->thread_count;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    ProcessChunks(pool, job);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pool->job = NULL;
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "entry_store.h"
+
+// Metadata fetch for the entries of one directory
+typedef struct StatJob {
+    int dirfd;
+    FileEntry *entries;
+    size_t count;
+    bool follow_links;
+    unsigned int mask;   // STATX_* fields to request
+    bool all_entries;    // false - only entries whose type is unknown (or symlinks when following)
+    int *errors;         // errors[i] receives 0 or errno of the failed stat
+} StatJob;
+
+typedef struct StatPool StatPool;
+
+// Whether the job has to stat this entry (its type is otherwise known from d_type)
+bool EntryNeedsStat(const StatJob *job, const FileEntry *entry);
+
+// Start a fixed pool of worker threads; the calling thread counts as one of the jobs
+// Returns NULL if threads or memory could not be allocated
+StatPool *NewStatPool(int jobs);
+// Stop the workers and free the pool
+void FreeStatPool(StatPool *pool);
+
+// Fill statbuf of the job entries; blocks until all the results are in
+// pool may be NULL, then the entries are processed serially
+void RunStatJob(StatPool *pool, const StatJob *job);
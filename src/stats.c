@@ -0,0 +1,105 @@
+#include "stats.h"
+
+#include <string.h>
+#include <time.h>
+
+bool stats_enabled = false;
+
+static unsigned long long phase_ns[STATS_PHASE_COUNT];
+static unsigned long long counters[STATS_COUNTER_COUNT];
+static long long store_bytes;
+static long long peak_store_bytes;
+static unsigned long long start_ns;
+
+// Текущая фаза потока и момент входа в нее
+static _Thread_local StatsPhase current_phase = STATS_PHASE_NONE;
+static _Thread_local unsigned long long phase_since;
+
+static unsigned long long NowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+void StartStats(void) {
+    memset(phase_ns, 0, sizeof(phase_ns));
+    memset(counters, 0, sizeof(counters));
+    store_bytes = 0;
+    peak_store_bytes = 0;
+    stats_enabled = true;
+    start_ns = NowNs();
+    phase_since = start_ns;
+    current_phase = STATS_PHASE_OTHER;
+}
+
+void StopStats(ListStats *stats) {
+    unsigned long long now = NowNs();
+    LeaveStatsPhase(STATS_PHASE_NONE);
+    stats_enabled = false;
+
+    stats->wall_ns = now - start_ns;
+    for (int i = 0; i < STATS_PHASE_COUNT; i++) {
+        stats->phase_ns[i] = __atomic_load_n(&phase_ns[i], __ATOMIC_RELAXED);
+    }
+    for (int i = 0; i < STATS_COUNTER_COUNT; i++) {
+        stats->counters[i] = __atomic_load_n(&counters[i], __ATOMIC_RELAXED);
+    }
+    stats->peak_store_bytes = (size_t)__atomic_load_n(&peak_store_bytes, __ATOMIC_RELAXED);
+}
+
+// Время с прошлого переключения начисляется фазе, из которой выходим
+static void SwitchPhase(StatsPhase phase) {
+    unsigned long long now = NowNs();
+    if (current_phase != STATS_PHASE_NONE) {
+        __atomic_add_fetch(&phase_ns[current_phase], now - phase_since, __ATOMIC_RELAXED);
+    }
+    phase_since = now;
+    current_phase = phase;
+}
+
+StatsPhase EnterStatsPhase(StatsPhase phase) {
+    StatsPhase previous = current_phase;
+    if (stats_enabled && phase != previous) {
+        SwitchPhase(phase);
+    }
+    return previous;
+}
+
+void LeaveStatsPhase(StatsPhase previous) {
+    if (stats_enabled && previous != current_phase) {
+        SwitchPhase(previous);
+    }
+}
+
+void AddStatsCounter(StatsCounter counter, unsigned long long value) {
+    __atomic_add_fetch(&counters[counter], value, __ATOMIC_RELAXED);
+}
+
+void AddStoreBytes(long long delta) {
+    if (!stats_enabled) return;
+    long long current = __atomic_add_fetch(&store_bytes, delta, __ATOMIC_RELAXED);
+    long long peak = __atomic_load_n(&peak_store_bytes, __ATOMIC_RELAXED);
+    while (current > peak &&
+           !__atomic_compare_exchange_n(&peak_store_bytes, &peak, current, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static double Ms(unsigned long long ns) {
+    return (double)ns / 1e6;
+}
+
+void PrintListStats(FILE *out, const ListStats *stats) {
+    const unsigned long long *phase = stats->phase_ns;
+    fprintf(out, "stats: wall %.3f ms; readdir %.3f ms, stat %.3f ms, nss %.3f ms, sort %.3f ms, "
+                 "format %.3f ms, output %.3f ms, other %.3f ms\n",
+            Ms(stats->wall_ns), Ms(phase[STATS_PHASE_READDIR]), Ms(phase[STATS_PHASE_STAT]), Ms(phase[STATS_PHASE_NSS]),
+            Ms(phase[STATS_PHASE_SORT]), Ms(phase[STATS_PHASE_FORMAT]), Ms(phase[STATS_PHASE_OUTPUT]),
+            Ms(phase[STATS_PHASE_OTHER]));
+
+    const unsigned long long *count = stats->counters;
+    fprintf(out, "stats: dirs %llu, dir reads %llu, entries %llu, stat calls %llu, readlinks %llu, nss lookups %llu, "
+                 "writes %llu, bytes written %llu, snapshot hits %llu, peak store %zu bytes\n",
+            count[STATS_DIRS], count[STATS_DIR_READS], count[STATS_ENTRIES], count[STATS_STAT_CALLS],
+            count[STATS_READLINKS], count[STATS_NSS_LOOKUPS], count[STATS_WRITES], count[STATS_BYTES_WRITTEN],
+            count[STATS_SNAPSHOT_HITS], stats->peak_store_bytes);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Phases of a listing; time outside of all of them goes to STATS_PHASE_OTHER
+typedef enum StatsPhase {
+    STATS_PHASE_NONE,     // Not accounted (idle worker threads)
+    STATS_PHASE_OTHER,
+    STATS_PHASE_READDIR,  // Opening and reading directories
+    STATS_PHASE_STAT,     // stat/statx of the entries
+    STATS_PHASE_NSS,      // uid/gid name lookups that missed the cache
+    STATS_PHASE_SORT,
+    STATS_PHASE_FORMAT,   // Rendering fields and lines
+    STATS_PHASE_OUTPUT,   // Handing the rendered lines to the output
+    STATS_PHASE_COUNT,
+} StatsPhase;
+
+typedef enum StatsCounter {
+    STATS_DIRS,           // Directories opened for listing
+    STATS_DIR_READS,      // getdents64 calls
+    STATS_ENTRIES,        // Entries collected
+    STATS_STAT_CALLS,     // stat/lstat/statx calls, including the ones queued to io_uring
+    STATS_READLINKS,
+    STATS_NSS_LOOKUPS,    // getpwuid/getgrgid calls
+    STATS_WRITES,         // write/writev calls of the output buffer
+    STATS_BYTES_WRITTEN,
+    STATS_SNAPSHOT_HITS,  // Directories served from the --cache snapshots
+    STATS_COUNTER_COUNT,
+} StatsCounter;
+
+// Counters of one ListPaths call
+// Phase times are wall time measured with CLOCK_MONOTONIC and summed over threads,
+// so with --jobs they may add up to more than wall_ns
+typedef struct ListStats {
+    unsigned long long wall_ns;
+    unsigned long long phase_ns[STATS_PHASE_COUNT];
+    unsigned long long counters[STATS_COUNTER_COUNT];
+    size_t peak_store_bytes;  // Peak memory of all live entry stores at once
+} ListStats;
+
+// Collection is process-wide and off by default; when it is off every hook is a single branch
+extern bool stats_enabled;
+
+// Reset the counters and start collecting
+void StartStats(void);
+// Stop collecting and copy the counters out
+void StopStats(ListStats *stats);
+
+// Switch the calling thread to a phase, returning the previous one for LeaveStatsPhase
+StatsPhase EnterStatsPhase(StatsPhase phase);
+void LeaveStatsPhase(StatsPhase previous);
+
+// Add to a counter; batch per-entry events where possible
+void AddStatsCounter(StatsCounter counter, unsigned long long value);
+// Track the memory of entry stores (delta may be negative)
+void AddStoreBytes(long long delta);
+
+// One-line summaries of phases and counters for --stats
+void PrintListStats(FILE *out, const ListStats *stats);
+
+static inline void CountStats(StatsCounter counter, unsigned long long value) {
+    if (stats_enabled) AddStatsCounter(counter, value);
+}
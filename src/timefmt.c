@@ -0,0 +1,260 @@
+#include "timefmt.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "outbuf.h"
+
+#define SECONDS_PER_DAY 86400
+#define NSEC_PER_SEC 1000000000LL
+// Полгода по определению GNU ls: средний григорианский год / 2
+#define SIX_MONTHS (31556952 / 2)
+#define DAY_CACHE_SIZE 64
+
+// Интервал [start, end), в котором дата и смещение от UTC постоянны
+// base_sod - секунды с полуночи в момент start
+typedef struct DayInterval {
+    time_t start;
+    time_t end;
+    long base_sod;
+    long gmtoff;
+    int year;
+    int mon;
+    int mday;
+} DayInterval;
+
+static pthread_once_t time_format_once = PTHREAD_ONCE_INIT;
+// Текущее время в наносекундах: одно атомарное чтение дает согласованный снимок всем потокам
+static long long current_time_ns;
+static char month_names[12][16];
+static size_t month_lens[12];
+
+// Кэш у каждого потока свой, поэтому блокировки не нужны
+static _Thread_local DayInterval day_cache[DAY_CACHE_SIZE];
+
+static void RefreshCurrentTime(struct timespec *now) {
+    clock_gettime(CLOCK_REALTIME, now);
+    __atomic_store_n(&current_time_ns, now->tv_sec * NSEC_PER_SEC + now->tv_nsec, __ATOMIC_RELAXED);
+}
+
+// Часовой пояс и названия месяцев определяются один раз, текущее время - заново
+// для каждой метки из будущего
+static void InitTimeFormat(void) {
+    tzset();
+    struct timespec now;
+    RefreshCurrentTime(&now);
+    for (int i = 0; i < 12; i++) {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        tm.tm_mon = i;
+        tm.tm_mday = 1;
+        tm.tm_year = 100;
+        month_lens[i] = strftime(month_names[i], sizeof(month_names[i]), "%b", &tm);
+    }
+}
+
+int ParseTimeStyle(const char *value, TimeStyle *style, const char **format) {
+    if (value[0] == '+') {
+        *style = TIME_STYLE_FORMAT;
+        *format = value + 1;
+    } else if (strcmp(value, "default") == 0) {
+        *style = TIME_STYLE_DEFAULT;
+    } else if (strcmp(value, "locale") == 0) {
+        *style = TIME_STYLE_LOCALE;
+    } else if (strcmp(value, "iso") == 0) {
+        *style = TIME_STYLE_ISO;
+    } else if (strcmp(value, "long-iso") == 0) {
+        *style = TIME_STYLE_LONG_ISO;
+    } else if (strcmp(value, "full-iso") == 0) {
+        *style = TIME_STYLE_FULL_ISO;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static time_t FloorDay(time_t t) {
+    time_t day = t / SECONDS_PER_DAY;
+    return (t % SECONDS_PER_DAY < 0) ? day - 1 : day;
+}
+
+static bool SameDate(const struct tm *a, const struct tm *b) {
+    return a->tm_year == b->tm_year && a->tm_mon == b->tm_mon && a->tm_mday == b->tm_mday && a->tm_gmtoff == b->tm_gmtoff;
+}
+
+// Интервал, содержащий t; localtime вызывается только при промахе
+static const DayInterval *LookupDay(time_t t) {
+    DayInterval *interval = &day_cache[(size_t)FloorDay(t) & (DAY_CACHE_SIZE - 1)];
+    if (interval->start <= t && t < interval->end) {
+        return interval;
+    }
+
+    struct tm tm;
+    if (!localtime_r(&t, &tm)) return NULL;
+    long sod = tm.tm_hour * 3600L + tm.tm_min * 60L + tm.tm_sec;
+
+    // Весь день целиком, если в нем не было перехода на летнее время;
+    // иначе кэшируется только сама секунда
+    time_t start = t - sod;
+    time_t last = start + SECONDS_PER_DAY - 1;
+    struct tm first_tm, last_tm;
+    if (sod < SECONDS_PER_DAY && localtime_r(&start, &first_tm) && localtime_r(&last, &last_tm) &&
+        SameDate(&first_tm, &tm) && first_tm.tm_hour == 0 && first_tm.tm_min == 0 && first_tm.tm_sec == 0 &&
+        SameDate(&last_tm, &tm) && last_tm.tm_hour == 23 && last_tm.tm_min == 59 && last_tm.tm_sec == 59) {
+        interval->start = start;
+        interval->end = start + SECONDS_PER_DAY;
+        interval->base_sod = 0;
+    } else {
+        interval->start = t;
+        interval->end = t + 1;
+        interval->base_sod = sod;
+    }
+    interval->gmtoff = tm.tm_gmtoff;
+    interval->year = tm.tm_year + 1900;
+    interval->mon = tm.tm_mon;
+    interval->mday = tm.tm_mday;
+    return interval;
+}
+
+static char *Put2(char *p, long value) {
+    p[0] = (char)('0' + value / 10);
+    p[1] = (char)('0' + value % 10);
+    return p + 2;
+}
+
+// Год как у strftime("%Y"): без дополнения нулями, со знаком для отрицательных
+static char *PutYear(char *p, int year) {
+    if (year < 0) {
+        *p++ = '-';
+        return p + FormatUnsigned(p, -(unsigned long long)year);
+    }
+    return p + FormatUnsigned(p, (unsigned long long)year);
+}
+
+static char *PutIsoDate(char *p, const DayInterval *day) {
+    p = PutYear(p, day->year);
+    *p++ = '-';
+    p = Put2(p, day->mon + 1);
+    *p++ = '-';
+    return Put2(p, day->mday);
+}
+
+static char *PutHourMinute(char *p, long sod) {
+    p = Put2(p, sod / 3600);
+    *p++ = ':';
+    return Put2(p, sod / 60 % 60);
+}
+
+static bool NotAfter(const struct timespec *when, const struct timespec *now) {
+    return when->tv_sec < now->tv_sec || (when->tv_sec == now->tv_sec && when->tv_nsec <= now->tv_nsec);
+}
+
+// Как в GNU ls: метка из будущего сначала сверяется с заново прочитанными часами,
+// иначе в долгом --watch все файлы, созданные после запуска, считались бы будущими
+static bool IsRecent(const struct timespec *when) {
+    long long ns = __atomic_load_n(&current_time_ns, __ATOMIC_RELAXED);
+    struct timespec now = {(time_t)(ns / NSEC_PER_SEC), (long)(ns % NSEC_PER_SEC)};
+    if (!NotAfter(when, &now)) {
+        RefreshCurrentTime(&now);
+    }
+
+    struct timespec six_months_ago = {now.tv_sec - SIX_MONTHS, now.tv_nsec};
+    return !NotAfter(when, &six_months_ago) && NotAfter(when, &now);
+}
+
+// Произвольный формат пользователя: строка до '\n' для недавних файлов, после - для старых
+static size_t FormatWithStrftime(char *buf, size_t size, time_t t, const char *format, bool recent) {
+    char local_format[256];
+    const char *newline = strchr(format, '\n');
+    if (newline) {
+        if (recent) {
+            snprintf(local_format, sizeof(local_format), "%.*s", (int)(newline - format), format);
+            format = local_format;
+        } else {
+            format = newline + 1;
+        }
+    }
+
+    struct tm tm;
+    buf[0] = '\0';
+    if (!localtime_r(&t, &tm)) return 0;
+    return strftime(buf, size, format, &tm);
+}
+
+size_t FormatTimestamp(char *buf, size_t size, const struct timespec *when, TimeStyle style, const char *format) {
+    pthread_once(&time_format_once, InitTimeFormat);
+    bool recent = IsRecent(when);
+    if (style == TIME_STYLE_FORMAT) {
+        return FormatWithStrftime(buf, size, when->tv_sec, format, recent);
+    }
+
+    const DayInterval *day = LookupDay(when->tv_sec);
+    if (!day || size < TIMESTAMP_MAX) {
+        // Время вне диапазона struct tm выводится числом секунд, как в GNU ls
+        return (size_t)snprintf(buf, size, "%lld", (long long)when->tv_sec);
+    }
+    long sod = day->base_sod + (long)(when->tv_sec - day->start);
+
+    char *p = buf;
+    switch (style) {
+        case TIME_STYLE_DEFAULT:
+        case TIME_STYLE_LOCALE:
+            // "%b %e %H:%M" либо "%b %e  %Y"
+            memcpy(p, month_names[day->mon], month_lens[day->mon]);
+            p += month_lens[day->mon];
+            *p++ = ' ';
+            *p++ = (day->mday < 10) ? ' ' : (char)('0' + day->mday / 10);
+            *p++ = (char)('0' + day->mday % 10);
+            *p++ = ' ';
+            if (style == TIME_STYLE_DEFAULT || recent) {
+                p = PutHourMinute(p, sod);
+            } else {
+                *p++ = ' ';
+                p = PutYear(p, day->year);
+            }
+            break;
+        case TIME_STYLE_ISO:
+            if (recent) {
+                p = Put2(p, day->mon + 1);
+                *p++ = '-';
+                p = Put2(p, day->mday);
+                *p++ = ' ';
+                p = PutHourMinute(p, sod);
+            } else {
+                p = PutIsoDate(p, day);
+                *p++ = ' ';
+            }
+            break;
+        case TIME_STYLE_LONG_ISO:
+            p = PutIsoDate(p, day);
+            *p++ = ' ';
+            p = PutHourMinute(p, sod);
+            break;
+        default: {
+            // full-iso: "%Y-%m-%d %H:%M:%S.%N %z"
+            p = PutIsoDate(p, day);
+            *p++ = ' ';
+            p = PutHourMinute(p, sod);
+            *p++ = ':';
+            p = Put2(p, sod % 60);
+            *p++ = '.';
+            long nsec = when->tv_nsec;
+            for (int i = 8; i >= 0; i--) {
+                p[i] = (char)('0' + nsec % 10);
+                nsec /= 10;
+            }
+            p += 9;
+            *p++ = ' ';
+            long offset = day->gmtoff / 60;
+            *p++ = (day->gmtoff < 0) ? '-' : '+';
+            if (offset < 0) offset = -offset;
+            p = Put2(p, offset / 60);
+            p = Put2(p, offset % 60);
+            break;
+        }
+    }
+    *p = '\0';
+    return (size_t)(p - buf);
+}
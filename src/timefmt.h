@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+#include <time.h>
+
+// Longest timestamp produced by the built-in styles, including the terminating NUL
+#define TIMESTAMP_MAX 64
+
+// Timestamp styles of the long format (--time-style)
+typedef enum TimeStyle {
+    TIME_STYLE_DEFAULT,   // "%b %e %H:%M" for every file
+    TIME_STYLE_LOCALE,    // GNU rule: "%b %e  %Y" for files older than six months or in the future
+    TIME_STYLE_ISO,       // "%m-%d %H:%M", or "%Y-%m-%d " for old and future files
+    TIME_STYLE_LONG_ISO,  // "%Y-%m-%d %H:%M"
+    TIME_STYLE_FULL_ISO,  // "%Y-%m-%d %H:%M:%S.%N %z"
+    TIME_STYLE_FORMAT,    // strftime format; "RECENT\nOLD" gives separate formats for old files
+} TimeStyle;
+
+// Parse a --time-style value ("+FORMAT" selects TIME_STYLE_FORMAT and sets *format)
+// Returns 0 on success or -1 for an unknown style
+int ParseTimeStyle(const char *value, TimeStyle *style, const char **format);
+
+// Render a timestamp into buf and return its length
+// The built-in styles need TIMESTAMP_MAX bytes; a FORMAT that does not fit gives an empty string
+// Local time is resolved through a per-thread cache of day intervals, so the date and
+// time are computed arithmetically and localtime runs only for days not seen before
+// A timestamp in the future re-reads the clock before the six-month rule is applied, as GNU ls does
+size_t FormatTimestamp(char *buf, size_t size, const struct timespec *when, TimeStyle style, const char *format);
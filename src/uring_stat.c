@@ -0,0 +1,215 @@
+#include "uring_stat.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "dirscan.h"
+#include "stats.h"
+
+struct UringStat {
+    int fd;
+    unsigned int depth;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_mask;
+    unsigned int *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    void *cq_ring;
+    size_t cq_ring_size;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // Буферы statx для запросов в полете и индексы их записей
+    struct statx *results;
+    size_t *slot_entry;
+    unsigned int *free_slots;
+    unsigned int free_count;
+};
+
+// Проверка поддержки IORING_OP_STATX ядром
+bool UringSupportsStatx(int fd) {
+    size_t probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, probe_size);
+    if (!probe) return false;
+
+    bool supported = false;
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+        supported = probe->last_op >= IORING_OP_STATX && (probe->ops[IORING_OP_STATX].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return supported;
+}
+
+UringStat *NewUringStat(unsigned int depth) {
+    UringStat *ring = calloc(1, sizeof(UringStat));
+    if (!ring) return NULL;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, depth, &params);
+    if (ring->fd < 0) {
+        free(ring);
+        return NULL;
+    }
+    ring->sq_ring = MAP_FAILED;
+    ring->cq_ring = MAP_FAILED;
+    ring->sqes = MAP_FAILED;
+    if (!UringSupportsStatx(ring->fd)) {
+        FreeUringStat(ring);
+        return NULL;
+    }
+    ring->depth = params.sq_entries;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap && ring->cq_ring_size > ring->sq_ring_size) {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        FreeUringStat(ring);
+        return NULL;
+    }
+    if (single_mmap) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            FreeUringStat(ring);
+            return NULL;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        FreeUringStat(ring);
+        return NULL;
+    }
+
+    char *sq = ring->sq_ring;
+    ring->sq_head = (unsigned int *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned int *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned int *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned int *)(sq + params.sq_off.array);
+    char *cq = ring->cq_ring;
+    ring->cq_head = (unsigned int *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned int *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    ring->results = malloc(ring->depth * sizeof(struct statx));
+    ring->slot_entry = malloc(ring->depth * sizeof(size_t));
+    ring->free_slots = malloc(ring->depth * sizeof(unsigned int));
+    if (!ring->results || !ring->slot_entry || !ring->free_slots) {
+        FreeUringStat(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+void FreeUringStat(UringStat *ring) {
+    if (!ring) return;
+    if (ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+    free(ring->results);
+    free(ring->slot_entry);
+    free(ring->free_slots);
+    free(ring);
+}
+
+// Постановка запроса statx для записи idx в очередь отправки
+void QueueStatx(UringStat *ring, const StatJob *job, size_t idx) {
+    unsigned int slot = ring->free_slots[--ring->free_count];
+    ring->slot_entry[slot] = idx;
+
+    unsigned int tail = *ring->sq_tail;
+    unsigned int pos = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[pos];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = job->dirfd;
+    sqe->addr = (uint64_t)(uintptr_t)job->entries[idx].name;
+    sqe->len = job->mask;
+    sqe->addr2 = (uint64_t)(uintptr_t)&ring->results[slot];
+    sqe->statx_flags = job->follow_links ? 0 : AT_SYMLINK_NOFOLLOW;
+    sqe->user_data = slot;
+    ring->sq_array[pos] = pos;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+// Разбор всех готовых завершений; возвращает их число
+unsigned int ReapCompletions(UringStat *ring, const StatJob *job) {
+    unsigned int head = *ring->cq_head;
+    unsigned int tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    unsigned int reaped = 0;
+
+    while (head != tail) {
+        const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        unsigned int slot = (unsigned int)cqe->user_data;
+        size_t idx = ring->slot_entry[slot];
+        if (cqe->res < 0) {
+            job->errors[idx] = -cqe->res;
+        } else {
+            StatxToStat(&ring->results[slot], &job->entries[idx].statbuf);
+        }
+        ring->free_slots[ring->free_count++] = slot;
+        head++;
+        reaped++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return reaped;
+}
+
+bool RunUringStatJob(UringStat *ring, const StatJob *job) {
+    ring->free_count = 0;
+    for (unsigned int slot = ring->depth; slot > 0; slot--) {
+        ring->free_slots[ring->free_count++] = slot - 1;
+    }
+
+    size_t next = 0;
+    unsigned int in_flight = 0;
+    unsigned int to_submit = 0;
+    size_t queued = 0;
+    while (next < job->count || in_flight > 0) {
+        // Очередь пополняется, пока не достигнут предел запросов в полете
+        while (next < job->count && ring->free_count > 0) {
+            job->errors[next] = 0;
+            if (EntryNeedsStat(job, &job->entries[next])) {
+                QueueStatx(ring, job, next);
+                in_flight++;
+                to_submit++;
+                queued++;
+            }
+            next++;
+        }
+        if (in_flight == 0) break;
+
+        int submitted = (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (submitted < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        to_submit -= (unsigned int)submitted;
+        in_flight -= ReapCompletions(ring, job);
+    }
+    CountStats(STATS_STAT_CALLS, queued);
+    return true;
+}
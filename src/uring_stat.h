@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "stat_pool.h"
+
+typedef struct UringStat UringStat;
+
+// Set up an io_uring with the given queue depth for batched statx
+// Returns NULL if io_uring or IORING_OP_STATX is not available
+UringStat *NewUringStat(unsigned int depth);
+// Tear down the ring
+void FreeUringStat(UringStat *ring);
+
+// Fill the job entries with IORING_OP_STATX, keeping at most depth requests in flight
+// Returns false if the ring failed; the caller should then redo the job synchronously
+bool RunUringStatJob(UringStat *ring, const StatJob *job);
@@ -2,81 +2,279 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+
+#define VECTOR_MIN_CAPACITY 4
+#define VECTOR_BLOCK_MIN_SIZE 1024
+#define VECTOR_BLOCK_MAX_SIZE (64 * 1024)
+
+// Блок арены вектора; текущий блок - первый в списке
+typedef struct VectorBlock {
+    struct VectorBlock* next;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+} VectorBlock;
 
 struct GenericVector {
     void** arr_;
     size_t len_;
     size_t capacity_;
+    ElementDestructor destroy_;  // NULL - элементы не принадлежат вектору
+    bool arena_;                 // Память элементов выделяется в арене
+    VectorBlock* blocks_;
+    VectorBlock* last_block_;    // Хвост списка блоков для переноса арены за O(1)
 };
 
-// Создание нового вектора
-GenericVector* NewGenericVector(size_t capacity) {
+// Число выделений памяти всеми векторами процесса
+static size_t vector_allocations;
+
+static void CountAllocation(void) {
+    __atomic_add_fetch(&vector_allocations, 1, __ATOMIC_RELAXED);
+}
+
+size_t GetVectorAllocations(void) {
+    return __atomic_load_n(&vector_allocations, __ATOMIC_RELAXED);
+}
+
+
+static GenericVector* NewVector(size_t capacity, ElementDestructor destroy, bool arena) {
     GenericVector* vector = (GenericVector*)malloc(sizeof(GenericVector));
     if (!vector) return NULL;
+    CountAllocation();
+    memset(vector, 0, sizeof(*vector));
+    vector->destroy_ = destroy;
+    vector->arena_ = arena;
 
-    vector->arr_ = malloc(capacity * sizeof(void*));
-    if (!vector->arr_) {
+    // Нулевая емкость допустима: массив выделяется при первом добавлении
+    if (!Reserve(vector, capacity)) {
         free(vector);
         return NULL;
     }
-    vector->len_ = 0;
-    vector->capacity_ = capacity;
-
     return vector;
 }
 
+// Создание нового вектора
+GenericVector* NewGenericVector(size_t capacity) {
+    return NewVector(capacity, free, false);
+}
+
+GenericVector* NewGenericVectorWith(size_t capacity, ElementDestructor destroy) {
+    return NewVector(capacity, destroy, false);
+}
+
+GenericVector* NewArenaVector(size_t capacity) {
+    return NewVector(capacity, NULL, true);
+}
+
+
+// Освобождение элементов, принадлежащих вектору; изъятые ячейки пусты
+static void DestroyElements(GenericVector* vector) {
+    if (!vector->destroy_) return;
+    for (size_t i = 0; i < vector->len_; i++) {
+        if (vector->arr_[i]) vector->destroy_(vector->arr_[i]);
+    }
+}
+
+static void FreeBlocks(VectorBlock* block) {
+    while (block) {
+        VectorBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
 // Освобождение памяти
 void FreeGenericVector(GenericVector* vector) {
     if (!vector) return;
 
-    // Освобождение каждого элемента, если он был выделен на куче
-    for (size_t i = 0; i < vector->len_; i++) {
-        // Если предполагается, что элементы вектора выделены на куче, можно их освободить
-        free(vector->arr_[i]);  // Здесь стоит убедиться, что элементы были динамически выделены
-    }
+    DestroyElements(vector);
+    FreeBlocks(vector->blocks_);
     free(vector->arr_);
     free(vector);
 }
 
+// Освобождение всех элементов без освобождения самого вектора
+// Арена сохраняет текущий блок для повторного использования
+void ClearGenericVector(GenericVector* vector) {
+    DestroyElements(vector);
+    vector->len_ = 0;
+    if (vector->blocks_) {
+        FreeBlocks(vector->blocks_->next);
+        vector->blocks_->next = NULL;
+        vector->blocks_->used = 0;
+        vector->last_block_ = vector->blocks_;
+    }
+}
+
+
+bool Reserve(GenericVector* vector, size_t capacity) {
+    if (capacity <= vector->capacity_) return true;
+    if (capacity > SIZE_MAX / sizeof(void*)) return false;
+    // Используем промежуточную переменную для безопасности realloc
+    void** new_arr = realloc(vector->arr_, capacity * sizeof(void*));
+    if (!new_arr) return false;
+    CountAllocation();
+    vector->arr_ = new_arr;
+    vector->capacity_ = capacity;
+    return true;
+}
+
+// Место под needed элементов с удвоением емкости, чтобы серия добавлений оставалась линейной
+static bool GrowTo(GenericVector* vector, size_t needed) {
+    if (needed <= vector->capacity_) return true;
+    size_t capacity = vector->capacity_ ? vector->capacity_ * 2 : VECTOR_MIN_CAPACITY;
+    if (capacity < needed) capacity = needed;
+    return Reserve(vector, capacity);
+}
+
 // Добавление элемента в конец вектора
-void Append(GenericVector* vector, void* elem) {
-    if (vector->len_ == vector->capacity_) {
-        // Используем промежуточную переменную для безопасности realloc
-        void** new_arr = realloc(vector->arr_, vector->capacity_ * 2 * sizeof(void*));
-        if (!new_arr) return;  // Если realloc не удался, возвращаемся без изменений
-        vector->arr_ = new_arr;  // Теперь обновляем указатель на новый массив
-        vector->capacity_ *= 2;
+bool Append(GenericVector* vector, void* elem) {
+    if (!GrowTo(vector, vector->len_ + 1)) return false;
+    vector->arr_[vector->len_++] = elem;
+    return true;
+}
+
+
+// Перенос блоков арены source в vector: текущим остается блок vector, блоки source встают за ним
+static void MoveBlocks(GenericVector* vector, GenericVector* source) {
+    if (!source->blocks_) return;
+    if (!vector->blocks_) {
+        vector->blocks_ = source->blocks_;
+        vector->last_block_ = source->last_block_;
+    } else {
+        source->last_block_->next = vector->blocks_->next;
+        if (vector->last_block_ == vector->blocks_) vector->last_block_ = source->last_block_;
+        vector->blocks_->next = source->blocks_;
+    }
+    source->blocks_ = NULL;
+    source->last_block_ = NULL;
+}
+
+// Перемещение всех элементов из source в vector
+bool Extend(GenericVector* vector, GenericVector* source) {
+    if (vector->len_ == 0 && vector->capacity_ < source->len_) {
+        // Пустому приемнику без нужной емкости достается массив источника целиком;
+        // зарезервированный массив заполняется копированием, как и непустой
+        void** arr = vector->arr_;
+        size_t capacity = vector->capacity_;
+        vector->arr_ = source->arr_;
+        vector->capacity_ = source->capacity_;
+        vector->len_ = source->len_;
+        source->arr_ = arr;
+        source->capacity_ = capacity;
+    } else {
+        if (source->len_ > SIZE_MAX - vector->len_) return false;
+        if (!GrowTo(vector, vector->len_ + source->len_)) return false;
+        if (source->len_ > 0) {
+            memcpy(vector->arr_ + vector->len_, source->arr_, source->len_ * sizeof(void*));
+        }
+        vector->len_ += source->len_;
     }
+    source->len_ = 0;
+    MoveBlocks(vector, source);
+    return true;
+}
 
-    vector->arr_[(vector->len_++)] = elem;
+// Изъятие элемента: ячейка обнуляется, освобождать элемент должен вызывающий
+void* TakeElement(GenericVector* vector, size_t idx) {
+    if (idx >= vector->len_) return NULL;
+    void* elem = vector->arr_[idx];
+    vector->arr_[idx] = NULL;
+    return elem;
 }
 
-// // Перемещение всех элементов из source в vector
-// void Extend(GenericVector* vector, GenericVector* source) {
-//     for (size_t i = 0; i < source->len_; i++) {
-//         Append(vector, source->arr_[i]);
-//         source->arr_[i] = NULL; // Обнуляем ссылку на перенесенный элемент
-//     }
-//     source->len_ = 0;
-// }
+// Обмен содержимым двух векторов
+void SwapGenericVectors(GenericVector* a, GenericVector* b) {
+    GenericVector tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
 
 // Получение элемента по индексу
 void* GetElement(const GenericVector* vector, size_t idx) {
     return (idx < vector->len_) ? vector->arr_[idx] : NULL;
 }
 
-// // Получение указателя на массив данных
-// void** GetData(GenericVector* vector) {
-//     return vector->arr_;
-// }
+
+// Выделение в арене с выравниванием align (степень двойки)
+// Блоки растут вдвое до VECTOR_BLOCK_MAX_SIZE; крупный элемент получает собственный блок
+// за текущим, чтобы не терять остаток текущего блока
+static void* ArenaAlloc(GenericVector* vector, size_t size, size_t align) {
+    VectorBlock* block = vector->blocks_;
+    if (block) {
+        size_t offset = (block->used + align - 1) & ~(align - 1);
+        if (offset <= block->size && block->size - offset >= size) {
+            block->used = offset + size;
+            return (char*)block->data + offset;
+        }
+    }
+
+    size_t block_size = block ? block->size * 2 : VECTOR_BLOCK_MIN_SIZE;
+    if (block_size > VECTOR_BLOCK_MAX_SIZE) block_size = VECTOR_BLOCK_MAX_SIZE;
+    bool dedicated = size > block_size;
+    if (dedicated) block_size = size;
+    if (block_size > SIZE_MAX - sizeof(VectorBlock)) return NULL;
+
+    VectorBlock* new_block = malloc(sizeof(VectorBlock) + block_size);
+    if (!new_block) return NULL;
+    CountAllocation();
+    new_block->size = block_size;
+    new_block->used = size;
+    if (dedicated && block) {
+        new_block->next = block->next;
+        block->next = new_block;
+        if (vector->last_block_ == block) vector->last_block_ = new_block;
+    } else {
+        new_block->next = block;
+        vector->blocks_ = new_block;
+        if (!vector->last_block_) vector->last_block_ = new_block;
+    }
+    return new_block->data;
+}
+
+void* AllocElement(GenericVector* vector, size_t size) {
+    if (vector->arena_) return ArenaAlloc(vector, size, _Alignof(max_align_t));
+    void* elem = malloc(size);
+    if (elem) CountAllocation();
+    return elem;
+}
+
+char* AllocString(GenericVector* vector, size_t len) {
+    if (len == SIZE_MAX) return NULL;
+    if (vector->arena_) return ArenaAlloc(vector, len + 1, 1);
+    char* str = malloc(len + 1);
+    if (str) CountAllocation();
+    return str;
+}
+
+char* AppendString(GenericVector* vector, const char* str, size_t len) {
+    char* copy = AllocString(vector, len);
+    if (!copy) return NULL;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    if (!Append(vector, copy)) {
+        // Место в арене просто остается неиспользованным
+        if (!vector->arena_) free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+
+// Получение указателя на массив данных
+void** GetData(GenericVector* vector) {
+    return vector->arr_;
+}
 
 // Получение текущей длины
 size_t GetLength(const GenericVector* vector) {
     return vector->len_;
 }
 
-// // Проверка, пуст ли вектор
-// bool IsEmpty(const GenericVector* vector) {
-//     return (vector->len_ == 0);
-// }
+// Проверка, пуст ли вектор
+bool IsEmpty(const GenericVector* vector) {
+    return (vector->len_ == 0);
+}
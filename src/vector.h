@@ -5,24 +5,61 @@
 
 typedef struct GenericVector GenericVector;
 
-// Allocate an array of specified capacity and zero length
+// Release an element owned by a vector
+typedef void (*ElementDestructor)(void* elem);
+
+// Allocate an array of specified capacity (may be zero) and zero length
+// Elements are owned by the vector and released with free()
+// Returns NULL if memory allocation failed
 GenericVector* NewGenericVector(size_t capacity);
-// Free allocated memory
-// Each array element should also be freed in case it was previously allocated on heap
+// Same with a custom element destructor; NULL means the elements are not owned
+GenericVector* NewGenericVectorWith(size_t capacity, ElementDestructor destroy);
+// Vector with its own bump arena: elements from AllocElement/AllocString live in the arena
+// and are released all at once, elements appended by pointer are not owned
+GenericVector* NewArenaVector(size_t capacity);
+// Free allocated memory: owned elements, the arena and the vector itself
 void FreeGenericVector(GenericVector* vector);
+// Free all the elements and set vector length to zero, keeping the vector and its capacity
+void ClearGenericVector(GenericVector* vector);
 
-// Append an element to the array
-// Assume the element was allocated on heap
-void Append(GenericVector* vector, void* elem);
-// Move all the elements from the source vector to the destination vector
-// Source vector length is assumed to be zero afterwards
-void Extend(GenericVector* vector, GenericVector* source);
+// Make room for at least capacity elements in total
+// Returns false if memory allocation failed (the vector is unchanged)
+bool Reserve(GenericVector* vector, size_t capacity);
+// Append an element to the array; it becomes owned as described at construction
+// Returns false if memory allocation failed, the element is not taken then
+bool Append(GenericVector* vector, void* elem);
+// Move all the elements from the source vector to the destination vector, along with
+// the arena blocks they live in; the source keeps zero length and an empty arena
+// Costs O(source length): the source pointers are copied after the destination's own;
+// only an empty destination with too little capacity takes over the source array instead
+// Arena blocks move in O(1). Both vectors must release elements the same way
+// Returns false if memory allocation failed (both vectors are unchanged)
+bool Extend(GenericVector* vector, GenericVector* source);
+// Take an element out of the array: the slot is left NULL and the caller owns the element
+// (an arena element stays valid only as long as the arena)
+void* TakeElement(GenericVector* vector, size_t idx);
+// Exchange the contents of two vectors
+void SwapGenericVectors(GenericVector* a, GenericVector* b);
 // Get an array element by its index
 void* GetElement(const GenericVector* vector, size_t idx);
 
+// Memory for a future element, suitably aligned: from the arena of an arena vector,
+// otherwise from malloc, to be released by the element destructor once appended
+// Returns NULL if memory allocation failed
+void* AllocElement(GenericVector* vector, size_t size);
+// Same for a string of length len: len + 1 bytes without alignment padding
+char* AllocString(GenericVector* vector, size_t len);
+// Copy a string of length len (NUL-terminated) and append the copy
+// Returns the copy or NULL if memory allocation failed
+char* AppendString(GenericVector* vector, const char* str, size_t len);
+
 // Get raw pointer on the underlying array of elements
 void** GetData(GenericVector* vector);
 // Get vector length
 size_t GetLength(const GenericVector* vector);
 // Check whether the vector is empty
 bool IsEmpty(const GenericVector* vector);
+
+// Allocations made by all vectors of the process so far: arrays, arena blocks and
+// element memory from malloc
+size_t GetVectorAllocations(void);
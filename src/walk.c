@@ -0,0 +1,354 @@
+#include "walk.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+// Предел готового, но еще не выведенного листинга: выше него потоки не берут новые узлы
+#define WALK_BUFFER_LIMIT (4 * 1024 * 1024)
+
+// Директория дерева обхода; ее листинг буферизуется до момента вывода
+typedef struct WalkNode {
+    const char *path;          // принадлежит вектору subdirs родителя
+    char *output;
+    size_t output_len;
+    GenericVector *subdirs;
+    struct WalkNode *children;
+    size_t child_count;
+    ListErrorCode status;
+    int deque;                 // очередь, в которую узел положен
+    bool done;
+} WalkNode;
+
+// Очередь потока: владелец берет с конца (обход в глубину),
+// остальные потоки воруют с начала (самые старые, обычно крупные поддеревья)
+// Узел, изъятый из середины для вывода, оставляет пустую ячейку
+typedef struct WalkDeque {
+    pthread_mutex_t lock;
+    WalkNode **items;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+} WalkDeque;
+
+typedef struct WalkShared {
+    WalkVisitFn visit;
+    void *ctx;
+    bool headers;
+    WalkDeque *deques;
+    int worker_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t node_done;
+    pthread_cond_t output_drained;
+    size_t queued;        // узлы в очередях
+    size_t outstanding;   // узлы, еще не обработанные до конца
+    size_t buffered;      // байты листингов готовых узлов, ожидающих вывода
+    size_t buffer_limit;
+} WalkShared;
+
+typedef struct WalkWorker {
+    WalkShared *shared;
+    int id;
+} WalkWorker;
+
+
+// Заголовок "path:" директории, перед всеми, кроме первой, - пустая строка
+void WriteHeader(const char *path, bool headers, FILE *out, bool *first) {
+    if (headers) {
+        int header = fprintf(out, "%s%s:\n", *first ? "" : "\n", path);
+        if (header > 0) CountStats(STATS_BYTES_WRITTEN, (unsigned long long)header);
+    }
+    *first = false;
+}
+
+
+// Последовательный обход: листинг сразу пишется в out
+ListErrorCode WalkSequential(const char *path, bool headers, WalkVisitFn visit, void *ctx, FILE *out, bool *first) {
+    WriteHeader(path, headers, out, first);
+
+    GenericVector *subdirs = NewArenaVector(4);
+    if (!subdirs) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
+    }
+
+    ListErrorCode result = visit(path, out, subdirs, ctx);
+    for (size_t i = 0; i < GetLength(subdirs); i++) {
+        ListErrorCode code = WalkSequential(GetElement(subdirs, i), headers, visit, ctx, out, first);
+        if (result == LIST_SUCCESS) result = code;
+    }
+    FreeGenericVector(subdirs);
+    return result;
+}
+
+
+bool PushNode(WalkShared *shared, int id, WalkNode *node) {
+    WalkDeque *deque = &shared->deques[id];
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail == deque->capacity) {
+        if (deque->head > 0) {
+            memmove(deque->items, deque->items + deque->head, (deque->tail - deque->head) * sizeof(WalkNode *));
+            deque->tail -= deque->head;
+            deque->head = 0;
+        } else {
+            size_t new_capacity = deque->capacity ? deque->capacity * 2 : 64;
+            WalkNode **new_items = realloc(deque->items, new_capacity * sizeof(WalkNode *));
+            if (!new_items) {
+                pthread_mutex_unlock(&deque->lock);
+                return false;
+            }
+            deque->items = new_items;
+            deque->capacity = new_capacity;
+        }
+    }
+    node->deque = id;
+    deque->items[deque->tail++] = node;
+    pthread_mutex_unlock(&deque->lock);
+
+    __atomic_add_fetch(&shared->queued, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&shared->lock);
+    pthread_cond_signal(&shared->work_ready);
+    pthread_mutex_unlock(&shared->lock);
+    return true;
+}
+
+WalkNode *TakeFromDeque(WalkDeque *deque, bool own) {
+    WalkNode *node = NULL;
+    pthread_mutex_lock(&deque->lock);
+    while (!node && deque->head < deque->tail) {
+        node = own ? deque->items[--deque->tail] : deque->items[deque->head++];
+    }
+    if (deque->head == deque->tail) {
+        deque->head = 0;
+        deque->tail = 0;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return node;
+}
+
+// Изъятие конкретного узла из очереди; поиск с конца, куда владелец кладет ближайшие к выводу узлы
+bool RemoveFromDeque(WalkShared *shared, WalkNode *node) {
+    WalkDeque *deque = &shared->deques[node->deque];
+    bool found = false;
+    pthread_mutex_lock(&deque->lock);
+    for (size_t i = deque->tail; !found && i > deque->head; i--) {
+        if (deque->items[i - 1] == node) {
+            deque->items[i - 1] = NULL;
+            found = true;
+        }
+    }
+    pthread_mutex_unlock(&deque->lock);
+    if (found) {
+        __atomic_sub_fetch(&shared->queued, 1, __ATOMIC_SEQ_CST);
+    }
+    return found;
+}
+
+// Сначала своя очередь, затем кража у остальных потоков по кругу
+WalkNode *TakeNode(WalkShared *shared, int id) {
+    WalkNode *node = TakeFromDeque(&shared->deques[id], true);
+    for (int i = 1; !node && i < shared->worker_count; i++) {
+        node = TakeFromDeque(&shared->deques[(id + i) % shared->worker_count], false);
+    }
+    if (node) {
+        __atomic_sub_fetch(&shared->queued, 1, __ATOMIC_SEQ_CST);
+    }
+    return node;
+}
+
+void ProcessNode(WalkShared *shared, int id, WalkNode *node) {
+    FILE *mem = open_memstream(&node->output, &node->output_len);
+    node->subdirs = NewArenaVector(4);
+    if (!mem || !node->subdirs) {
+        fprintf(stderr, "Memory allocation failed\n");
+        node->status = LIST_ERR_MEMORY;
+    } else {
+        node->status = shared->visit(node->path, mem, node->subdirs, shared->ctx);
+    }
+    if (mem) fclose(mem);
+
+    size_t count = node->subdirs ? GetLength(node->subdirs) : 0;
+    if (count > 0) {
+        node->children = calloc(count, sizeof(WalkNode));
+        if (!node->children) {
+            fprintf(stderr, "Memory allocation failed\n");
+            node->status = LIST_ERR_MEMORY;
+            count = 0;
+        }
+    }
+    node->child_count = count;
+    __atomic_add_fetch(&shared->outstanding, count, __ATOMIC_SEQ_CST);
+
+    // Дети кладутся в обратном порядке, чтобы владелец брал их в порядке вывода
+    for (size_t i = count; i > 0; i--) {
+        WalkNode *child = &node->children[i - 1];
+        child->path = GetElement(node->subdirs, i - 1);
+        if (!PushNode(shared, id, child)) {
+            // Без места в очереди поддерево обрабатывается сразу
+            ProcessNode(shared, id, child);
+        }
+    }
+
+    pthread_mutex_lock(&shared->lock);
+    node->done = true;
+    __atomic_add_fetch(&shared->buffered, node->output_len, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&shared->node_done);
+    pthread_mutex_unlock(&shared->lock);
+
+    if (__atomic_sub_fetch(&shared->outstanding, 1, __ATOMIC_SEQ_CST) == 0) {
+        pthread_mutex_lock(&shared->lock);
+        pthread_cond_broadcast(&shared->work_ready);
+        pthread_mutex_unlock(&shared->lock);
+    }
+}
+
+void *WalkWorkerMain(void *arg) {
+    WalkWorker *worker = arg;
+    WalkShared *shared = worker->shared;
+
+    for (;;) {
+        // Вывод отстает: новые узлы ждут, пока он не освободит буфер
+        if (__atomic_load_n(&shared->buffered, __ATOMIC_SEQ_CST) >= shared->buffer_limit) {
+            pthread_mutex_lock(&shared->lock);
+            while (__atomic_load_n(&shared->buffered, __ATOMIC_SEQ_CST) >= shared->buffer_limit) {
+                pthread_cond_wait(&shared->output_drained, &shared->lock);
+            }
+            pthread_mutex_unlock(&shared->lock);
+        }
+
+        WalkNode *node = TakeNode(shared, worker->id);
+        if (node) {
+            ProcessNode(shared, worker->id, node);
+            continue;
+        }
+
+        pthread_mutex_lock(&shared->lock);
+        while (__atomic_load_n(&shared->queued, __ATOMIC_SEQ_CST) == 0 &&
+               __atomic_load_n(&shared->outstanding, __ATOMIC_SEQ_CST) > 0) {
+            pthread_cond_wait(&shared->work_ready, &shared->lock);
+        }
+        bool finished = __atomic_load_n(&shared->outstanding, __ATOMIC_SEQ_CST) == 0;
+        pthread_mutex_unlock(&shared->lock);
+        if (finished) break;
+    }
+    return NULL;
+}
+
+// Вывод узла после его готовности, затем детей в порядке листинга
+// При заполненном буфере потоки стоят, и узел, еще лежащий в очереди, обрабатывается здесь же
+ListErrorCode EmitNode(WalkShared *shared, WalkNode *node, FILE *out, bool *first) {
+    pthread_mutex_lock(&shared->lock);
+    while (!node->done) {
+        if (__atomic_load_n(&shared->buffered, __ATOMIC_SEQ_CST) >= shared->buffer_limit && RemoveFromDeque(shared, node)) {
+            pthread_mutex_unlock(&shared->lock);
+            ProcessNode(shared, node->deque, node);
+            pthread_mutex_lock(&shared->lock);
+        } else {
+            pthread_cond_wait(&shared->node_done, &shared->lock);
+        }
+    }
+    pthread_mutex_unlock(&shared->lock);
+
+    StatsPhase previous = EnterStatsPhase(STATS_PHASE_OUTPUT);
+    WriteHeader(node->path, shared->headers, out, first);
+    if (node->output) {
+        CountStats(STATS_BYTES_WRITTEN, fwrite(node->output, 1, node->output_len, out));
+        free(node->output);
+        node->output = NULL;
+    }
+    LeaveStatsPhase(previous);
+
+    pthread_mutex_lock(&shared->lock);
+    size_t buffered = __atomic_sub_fetch(&shared->buffered, node->output_len, __ATOMIC_SEQ_CST);
+    if (buffered < shared->buffer_limit && buffered + node->output_len >= shared->buffer_limit) {
+        pthread_cond_broadcast(&shared->output_drained);
+    }
+    pthread_mutex_unlock(&shared->lock);
+
+    ListErrorCode result = node->status;
+    for (size_t i = 0; i < node->child_count; i++) {
+        ListErrorCode code = EmitNode(shared, &node->children[i], out, first);
+        if (result == LIST_SUCCESS) result = code;
+    }
+    free(node->children);
+    FreeGenericVector(node->subdirs);
+    return result;
+}
+
+ListErrorCode WalkTree(const char *root, int jobs, bool headers, WalkVisitFn visit, void *ctx, FILE *out) {
+    bool first = true;
+    if (jobs < 2) {
+        return WalkSequential(root, headers, visit, ctx, out, &first);
+    }
+
+    WalkShared shared;
+    memset(&shared, 0, sizeof(shared));
+    shared.visit = visit;
+    shared.ctx = ctx;
+    shared.headers = headers;
+    shared.deques = calloc((size_t)jobs, sizeof(WalkDeque));
+    pthread_t *threads = malloc((size_t)jobs * sizeof(pthread_t));
+    WalkWorker *workers = malloc((size_t)jobs * sizeof(WalkWorker));
+    if (!shared.deques || !threads || !workers) {
+        free(shared.deques);
+        free(threads);
+        free(workers);
+        return WalkSequential(root, headers, visit, ctx, out, &first);
+    }
+    pthread_mutex_init(&shared.lock, NULL);
+    pthread_cond_init(&shared.work_ready, NULL);
+    pthread_cond_init(&shared.node_done, NULL);
+    pthread_cond_init(&shared.output_drained, NULL);
+    shared.buffer_limit = WALK_BUFFER_LIMIT;
+    for (int i = 0; i < jobs; i++) {
+        pthread_mutex_init(&shared.deques[i].lock, NULL);
+    }
+    shared.worker_count = jobs;
+
+    WalkNode root_node;
+    memset(&root_node, 0, sizeof(root_node));
+    root_node.path = root;
+    shared.outstanding = 1;
+    ListErrorCode result;
+    if (!PushNode(&shared, 0, &root_node)) {
+        fprintf(stderr, "Memory allocation failed\n");
+        result = LIST_ERR_MEMORY;
+    } else {
+        int started = 0;
+        for (int i = 0; i < jobs; i++) {
+            workers[i].shared = &shared;
+            workers[i].id = i;
+            if (pthread_create(&threads[i], NULL, WalkWorkerMain, &workers[i]) != 0) break;
+            started++;
+        }
+        if (started == 0) {
+            // Потоки не запустились: вся работа выполняется в текущем, до вывода, без предела буфера
+            shared.buffer_limit = SIZE_MAX;
+            WalkWorkerMain(&workers[0]);
+        }
+
+        result = EmitNode(&shared, &root_node, out, &first);
+        for (int i = 0; i < started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    for (int i = 0; i < jobs; i++) {
+        pthread_mutex_destroy(&shared.deques[i].lock);
+        free(shared.deques[i].items);
+    }
+    pthread_mutex_destroy(&shared.lock);
+    pthread_cond_destroy(&shared.work_ready);
+    pthread_cond_destroy(&shared.node_done);
+    pthread_cond_destroy(&shared.output_drained);
+    free(shared.deques);
+    free(threads);
+    free(workers);
+    return result;
+}
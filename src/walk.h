@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "ls.h"
+#include "vector.h"
+
+// Listing of a single directory: writes it to out and appends full paths of the
+// subdirectories to descend into, in output order, with AppendString (subdirs is an arena vector)
+// May be called concurrently from several threads when jobs > 1
+typedef ListErrorCode (*WalkVisitFn)(const char *path, FILE *out, GenericVector *subdirs, void *ctx);
+
+// Recursive listing in GNU ls -R order: every directory is printed as a "path:" header
+// followed by its listing, directories are separated by a blank line and visited depth-first
+// With jobs > 1 worker threads list directories in parallel, stealing subdirectories
+// from each other, and every listing is buffered until its turn to be printed
+// Workers pause while finished listings waiting for output exceed 4 MiB; the printing
+// thread then lists the directory it needs next itself
+// Without headers the listings are concatenated with neither headers nor blank lines
+// Errors in subdirectories do not stop the walk; the first error code is returned
+ListErrorCode WalkTree(const char *root, int jobs, bool headers, WalkVisitFn visit, void *ctx, FILE *out);
@@ -0,0 +1,560 @@
+#define _GNU_SOURCE  // ppoll
+
+#include "watch.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "dirscan.h"
+#include "sort.h"
+#include "stats.h"
+
+volatile sig_atomic_t watch_stop_requested = 0;
+
+#define WATCH_TABLE_MIN_CAPACITY 64
+#define WATCH_PENDING_MIN_CAPACITY 16
+#define WATCH_EVENT_BUFFER_SIZE 65536
+
+// События, меняющие набор имен; с метаданными добавляются изменения самих файлов
+#define WATCH_NAME_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR)
+#define WATCH_STAT_EVENTS (IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE)
+
+// Запись индекса; имя и цель ссылки хранятся сразу за узлом
+typedef struct WatchNode {
+    uint64_t hash;
+    FileEntry entry;
+    char data[];
+} WatchNode;
+
+// Хеш-таблица узлов по имени с открытой адресацией и линейным пробированием
+typedef struct WatchIndex {
+    WatchNode **slots;
+    size_t capacity;
+    size_t count;
+} WatchIndex;
+
+typedef struct WatchedDir {
+    char *path;
+    int wd;          // -1 - директория больше не отслеживается
+    int dirfd;       // Переименование директории не мешает stat ее записей
+    WatchIndex index;
+    char **pending;  // Имена из событий текущей пачки, возможны повторы
+    size_t pending_count;
+    size_t pending_capacity;
+    bool rescan;     // События потеряны: сверяется вся директория
+} WatchedDir;
+
+struct DirWatch {
+    const ListArgs *args;
+    int fd;
+    bool need_stat;
+    bool link_targets;
+    WatchedDir *dirs;
+    size_t dir_count;
+    size_t dir_capacity;
+    size_t active;
+    char *link_buf;
+    size_t link_cap;
+};
+
+
+// FNV-1a по байтам имени
+static uint64_t HashName(const char *name, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+// Слот с этим именем либо пустой слот, где пробирование для него заканчивается
+static size_t FindIndexSlot(const WatchIndex *index, const char *name, size_t len, uint64_t hash) {
+    size_t mask = index->capacity - 1;
+    size_t idx = (size_t)hash & mask;
+    for (;;) {
+        const WatchNode *node = index->slots[idx];
+        if (!node) return idx;
+        if (node->hash == hash && node->entry.name_len == len && memcmp(node->entry.name, name, len) == 0) return idx;
+        idx = (idx + 1) & mask;
+    }
+}
+
+
+// Увеличение таблицы вдвое при заполнении более чем на 3/4
+static bool GrowIndex(WatchIndex *index) {
+    size_t new_capacity = index->capacity ? index->capacity * 2 : WATCH_TABLE_MIN_CAPACITY;
+    WatchNode **new_slots = calloc(new_capacity, sizeof(WatchNode *));
+    if (!new_slots) return false;
+
+    for (size_t i = 0; i < index->capacity; i++) {
+        WatchNode *node = index->slots[i];
+        if (!node) continue;
+        size_t idx = (size_t)node->hash & (new_capacity - 1);
+        while (new_slots[idx]) idx = (idx + 1) & (new_capacity - 1);
+        new_slots[idx] = node;
+    }
+    free(index->slots);
+    index->slots = new_slots;
+    index->capacity = new_capacity;
+    return true;
+}
+
+
+// Добавление узла, имени которого в таблице нет
+static bool InsertNode(WatchIndex *index, WatchNode *node) {
+    if ((index->count + 1) * 4 > index->capacity * 3 && !GrowIndex(index)) return false;
+    index->slots[FindIndexSlot(index, node->entry.name, node->entry.name_len, node->hash)] = node;
+    index->count++;
+    return true;
+}
+
+
+// Удаление со сдвигом следующих узлов цепочки назад, без надгробий
+static void RemoveSlot(WatchIndex *index, size_t idx) {
+    size_t mask = index->capacity - 1;
+    size_t hole = idx;
+    for (size_t next = (idx + 1) & mask; index->slots[next]; next = (next + 1) & mask) {
+        size_t home = (size_t)index->slots[next]->hash & mask;
+        // Узел остается на месте, если его исходный слот лежит циклически в (hole, next]
+        bool stays = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (stays) continue;
+        index->slots[hole] = index->slots[next];
+        hole = next;
+    }
+    index->slots[hole] = NULL;
+    index->count--;
+}
+
+
+static void FreeIndex(WatchIndex *index) {
+    for (size_t i = 0; i < index->capacity; i++) {
+        free(index->slots[i]);
+    }
+    free(index->slots);
+    index->slots = NULL;
+    index->capacity = 0;
+    index->count = 0;
+}
+
+
+static WatchNode *NewWatchNode(const char *name, size_t name_len, uint64_t hash, unsigned char type, const struct stat *statbuf,
+                               const char *target, size_t target_len) {
+    WatchNode *node = malloc(sizeof(WatchNode) + name_len + 1 + (target ? target_len + 1 : 0));
+    if (!node) return NULL;
+    node->hash = hash;
+    memcpy(node->data, name, name_len);
+    node->data[name_len] = '\0';
+    node->entry.name = node->data;
+    node->entry.name_len = (unsigned int)name_len;
+    node->entry.type = type;
+    node->entry.statbuf = *statbuf;
+    node->entry.target = NULL;
+    node->entry.target_len = 0;
+    if (target) {
+        char *copy = node->data + name_len + 1;
+        memcpy(copy, target, target_len);
+        copy[target_len] = '\0';
+        node->entry.target = copy;
+        node->entry.target_len = (unsigned int)target_len;
+    }
+    return node;
+}
+
+
+DirWatch *NewDirWatch(const ListArgs *args) {
+    DirWatch *watch = calloc(1, sizeof(DirWatch));
+    if (!watch) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd < 0) {
+        fprintf(stderr, "Could not start inotify: %s\n", strerror(errno));
+        free(watch);
+        return NULL;
+    }
+    watch->args = args;
+    return watch;
+}
+
+
+static void ClearPending(WatchedDir *dir) {
+    for (size_t i = 0; i < dir->pending_count; i++) {
+        free(dir->pending[i]);
+    }
+    dir->pending_count = 0;
+}
+
+
+void FreeDirWatch(DirWatch *watch) {
+    if (!watch) return;
+    for (size_t i = 0; i < watch->dir_count; i++) {
+        WatchedDir *dir = &watch->dirs[i];
+        ClearPending(dir);
+        free(dir->pending);
+        FreeIndex(&dir->index);
+        close(dir->dirfd);
+        free(dir->path);
+    }
+    free(watch->dirs);
+    free(watch->link_buf);
+    close(watch->fd);
+    free(watch);
+}
+
+
+// Посетитель первого листинга: записи копируются в индекс и передаются дальше
+typedef struct IndexingVisitor {
+    WatchedDir *dir;
+    const ListVisitor *inner;
+} IndexingVisitor;
+
+static ListErrorCode IndexBeginDir(void *ctx, const char *path, const struct stat *dir_stat) {
+    const ListVisitor *inner = ((IndexingVisitor *)ctx)->inner;
+    return inner->begin_dir ? inner->begin_dir(inner->ctx, path, dir_stat) : LIST_SUCCESS;
+}
+
+static ListErrorCode IndexEntries(void *ctx, const char *path, const FileEntry *const *entries, size_t count) {
+    IndexingVisitor *indexing = ctx;
+    WatchIndex *index = &indexing->dir->index;
+    for (size_t i = 0; i < count; i++) {
+        const FileEntry *entry = entries[i];
+        uint64_t hash = HashName(entry->name, entry->name_len);
+        WatchNode *node = NewWatchNode(entry->name, entry->name_len, hash, entry->type, &entry->statbuf, entry->target,
+                                       entry->target_len);
+        if (!node || !InsertNode(index, node)) {
+            free(node);
+            fprintf(stderr, "Memory allocation failed\n");
+            return LIST_ERR_MEMORY;
+        }
+    }
+    const ListVisitor *inner = indexing->inner;
+    return inner->entries ? inner->entries(inner->ctx, path, entries, count) : LIST_SUCCESS;
+}
+
+static ListErrorCode IndexEndDir(void *ctx, const char *path) {
+    const ListVisitor *inner = ((IndexingVisitor *)ctx)->inner;
+    return inner->end_dir ? inner->end_dir(inner->ctx, path) : LIST_SUCCESS;
+}
+
+
+ListErrorCode AddWatchedDirectory(DirWatch *watch, const char *path, const struct stat *dir_stat, StatEngines *engines,
+                                  const ListVisitor *visitor) {
+    watch->need_stat = visitor->need_stat;
+    watch->link_targets = visitor->link_targets;
+    if (watch->dir_count == watch->dir_capacity) {
+        size_t new_capacity = watch->dir_capacity ? watch->dir_capacity * 2 : 4;
+        WatchedDir *new_dirs = realloc(watch->dirs, new_capacity * sizeof(WatchedDir));
+        if (!new_dirs) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return LIST_ERR_MEMORY;
+        }
+        watch->dirs = new_dirs;
+        watch->dir_capacity = new_capacity;
+    }
+
+    WatchedDir *dir = &watch->dirs[watch->dir_count];
+    memset(dir, 0, sizeof(*dir));
+    dir->dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir->dirfd < 0) {
+        fprintf(stderr, "Could not open directory: %s\n", path);
+        return LIST_ERR_OPEN_DIR;
+    }
+    if (!(dir->path = strdup(path))) {
+        close(dir->dirfd);
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
+    }
+    // Подписка раньше листинга: изменения во время чтения придут событиями
+    uint32_t mask = WATCH_NAME_EVENTS | (visitor->need_stat ? WATCH_STAT_EVENTS : 0);
+    dir->wd = inotify_add_watch(watch->fd, path, mask);
+    if (dir->wd < 0) {
+        fprintf(stderr, "Could not watch directory %s: %s\n", path, strerror(errno));
+        close(dir->dirfd);
+        free(dir->path);
+        return LIST_ERR_OPEN_DIR;
+    }
+    // Та же директория под другим именем: события уже приходят в индекс первой
+    bool duplicate = false;
+    for (size_t i = 0; i < watch->dir_count; i++) {
+        duplicate = duplicate || watch->dirs[i].wd == dir->wd;
+    }
+    if (duplicate) {
+        close(dir->dirfd);
+        free(dir->path);
+        return VisitDirectoryEntries(path, dir_stat, watch->args, engines, visitor, NULL);
+    }
+    watch->dir_count++;
+    watch->active++;
+
+    IndexingVisitor indexing = {dir, visitor};
+    ListVisitor tee = *visitor;
+    tee.begin_dir = IndexBeginDir;
+    tee.entries = IndexEntries;
+    tee.end_dir = IndexEndDir;
+    tee.ctx = &indexing;
+    return VisitDirectoryEntries(path, dir_stat, watch->args, engines, &tee, NULL);
+}
+
+
+static bool AddPending(WatchedDir *dir, const char *name, size_t len) {
+    if (dir->pending_count == dir->pending_capacity) {
+        size_t new_capacity = dir->pending_capacity ? dir->pending_capacity * 2 : WATCH_PENDING_MIN_CAPACITY;
+        char **new_pending = realloc(dir->pending, new_capacity * sizeof(char *));
+        if (!new_pending) return false;
+        dir->pending = new_pending;
+        dir->pending_capacity = new_capacity;
+    }
+    char *copy = malloc(len + 1);
+    if (!copy) return false;
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    dir->pending[dir->pending_count++] = copy;
+    return true;
+}
+
+
+// После потери событий сверяются все известные имена и все имена директории
+static bool QueueAllNames(WatchedDir *dir) {
+    for (size_t i = 0; i < dir->index.capacity; i++) {
+        const WatchNode *node = dir->index.slots[i];
+        if (node && !AddPending(dir, node->entry.name, node->entry.name_len)) return false;
+    }
+    DirReader reader;
+    if (!OpenDirReaderAt(&reader, dir->dirfd, ".")) return true;
+    RawDirEntry entry;
+    bool ok = true;
+    while (ok && ReadDirEntry(&reader, &entry) > 0) {
+        ok = AddPending(dir, entry.name, entry.name_len);
+    }
+    CloseDirReader(&reader);
+    return ok;
+}
+
+
+// Текущее состояние имени в виде нового узла; *node = NULL, если записи больше нет
+// (с -L сюда же попадают битые ссылки, как и при листинге)
+static bool StatNode(DirWatch *watch, WatchedDir *dir, const char *name, size_t len, uint64_t hash, WatchNode **node) {
+    *node = NULL;
+    struct stat statbuf;
+    CountStats(STATS_STAT_CALLS, 1);
+    if (StatAt(dir->dirfd, name, watch->args->dereference, STATX_BASIC_STATS, &statbuf) != 0) return true;
+
+    const char *target = NULL;
+    ssize_t target_len = 0;
+    if (watch->link_targets && S_ISLNK(statbuf.st_mode)) {
+        if (!ReadLinkTarget(dir->dirfd, name, (size_t)statbuf.st_size, &watch->link_buf, &watch->link_cap, &target_len)) {
+            return false;
+        }
+        // Ссылку успели удалить или заменить: ее событие еще придет
+        if (target_len >= 0) {
+            target = watch->link_buf;
+        } else {
+            target_len = 0;
+        }
+    }
+    *node = NewWatchNode(name, len, hash, IFTODT(statbuf.st_mode), &statbuf, target, (size_t)target_len);
+    return *node != NULL;
+}
+
+
+// Изменилось ли что-то из выводимого; без метаданных видны только имена
+static bool NodeChanged(const DirWatch *watch, const WatchNode *old, const WatchNode *now) {
+    if (!watch->need_stat) return false;
+    const struct stat *a = &old->entry.statbuf;
+    const struct stat *b = &now->entry.statbuf;
+    if (a->st_mode != b->st_mode || a->st_nlink != b->st_nlink || a->st_uid != b->st_uid || a->st_gid != b->st_gid ||
+        a->st_size != b->st_size || a->st_blocks != b->st_blocks || a->st_mtim.tv_sec != b->st_mtim.tv_sec ||
+        a->st_mtim.tv_nsec != b->st_mtim.tv_nsec) {
+        return true;
+    }
+    if ((old->entry.target == NULL) != (now->entry.target == NULL)) return true;
+    return old->entry.target &&
+           (old->entry.target_len != now->entry.target_len || memcmp(old->entry.target, now->entry.target, old->entry.target_len) != 0);
+}
+
+
+static int ComparePendingNames(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+
+// Применение пачки к индексу: stat только для имен из событий, затем изменения в порядке вывода
+static ListErrorCode FlushDirectory(DirWatch *watch, WatchedDir *dir, const WatchSink *sink) {
+    if (dir->rescan) {
+        dir->rescan = false;
+        if (!QueueAllNames(dir)) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return LIST_ERR_MEMORY;
+        }
+    }
+    if (dir->pending_count == 0) return LIST_SUCCESS;
+    qsort(dir->pending, dir->pending_count, sizeof(char *), ComparePendingNames);
+
+    size_t count = dir->pending_count;
+    FileEntry *changes = malloc(count * sizeof(FileEntry));
+    WatchChange *change_kinds = malloc(count * sizeof(WatchChange));
+    WatchChange *kinds = malloc(count * sizeof(WatchChange));
+    WatchNode **released = malloc(count * sizeof(WatchNode *));
+    size_t change_count = 0;
+    size_t released_count = 0;
+    ListErrorCode code = LIST_SUCCESS;
+    if (!changes || !change_kinds || !kinds || !released) code = LIST_ERR_MEMORY;
+
+    if (dir->index.capacity == 0 && code == LIST_SUCCESS && !GrowIndex(&dir->index)) code = LIST_ERR_MEMORY;
+    for (size_t i = 0; code == LIST_SUCCESS && i < count; i++) {
+        const char *name = dir->pending[i];
+        if (i > 0 && strcmp(name, dir->pending[i - 1]) == 0) continue;
+        size_t len = strlen(name);
+        if (!EntryVisible(watch->args, name, len) || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+
+        uint64_t hash = HashName(name, len);
+        size_t slot = FindIndexSlot(&dir->index, name, len, hash);
+        WatchNode *old = dir->index.slots[slot];
+        WatchNode *now;
+        if (!StatNode(watch, dir, name, len, hash, &now)) {
+            code = LIST_ERR_MEMORY;
+            break;
+        }
+        if (!old && !now) continue;
+        if (old && now && !NodeChanged(watch, old, now)) {
+            free(now);
+            continue;
+        }
+
+        // Старый узел нужен до конца вывода: удаленная запись показывается по нему
+        if (old) {
+            RemoveSlot(&dir->index, slot);
+            released[released_count++] = old;
+        }
+        if (now && !InsertNode(&dir->index, now)) {
+            free(now);
+            code = LIST_ERR_MEMORY;
+            break;
+        }
+        changes[change_count] = now ? now->entry : old->entry;
+        change_kinds[change_count++] = !old ? WATCH_ADDED : (!now ? WATCH_REMOVED : WATCH_CHANGED);
+    }
+    ClearPending(dir);
+
+    if (code == LIST_SUCCESS && change_count > 0) {
+        StatsPhase previous = EnterStatsPhase(STATS_PHASE_SORT);
+        const FileEntry **order = SortEntries(changes, change_count, watch->args);
+        LeaveStatsPhase(previous);
+        if (order) {
+            for (size_t i = 0; i < change_count; i++) {
+                kinds[i] = change_kinds[order[i] - changes];
+            }
+            code = sink->changes(sink->ctx, dir->path, order, kinds, change_count);
+            free(order);
+        } else {
+            code = LIST_ERR_MEMORY;
+        }
+    }
+    if (code == LIST_ERR_MEMORY) fprintf(stderr, "Memory allocation failed\n");
+
+    for (size_t i = 0; i < released_count; i++) {
+        free(released[i]);
+    }
+    free(released);
+    free(kinds);
+    free(change_kinds);
+    free(changes);
+    return code;
+}
+
+
+static WatchedDir *FindWatchedDir(DirWatch *watch, int wd) {
+    for (size_t i = 0; i < watch->dir_count; i++) {
+        if (watch->dirs[i].wd == wd) return &watch->dirs[i];
+    }
+    return NULL;
+}
+
+
+// Разбор прочитанных событий: имена откладываются до конца пачки
+static bool QueueEvents(DirWatch *watch, const char *buf, size_t len) {
+    for (size_t pos = 0; pos < len;) {
+        const struct inotify_event *event = (const struct inotify_event *)(buf + pos);
+        pos += sizeof(struct inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            for (size_t i = 0; i < watch->dir_count; i++) {
+                watch->dirs[i].rescan = true;
+            }
+            continue;
+        }
+        WatchedDir *dir = FindWatchedDir(watch, event->wd);
+        if (!dir) continue;
+        if (event->mask & IN_IGNORED) {
+            // Директория удалена (или ее ФС отмонтирована), подписки больше нет
+            dir->wd = -1;
+            watch->active--;
+            continue;
+        }
+        if (event->len > 0 && !AddPending(dir, event->name, strlen(event->name))) return false;
+    }
+    return true;
+}
+
+
+ListErrorCode RunDirWatch(DirWatch *watch, const WatchSink *sink) {
+    char *buf = malloc(WATCH_EVENT_BUFFER_SIZE);
+    if (!buf) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return LIST_ERR_MEMORY;
+    }
+
+    // Сигналы завершения доставляются только внутри ppoll: пришедший во время чтения
+    // или вывода событий ждет ожидания и прерывает его, а флаг проверяется перед ним
+    sigset_t wait_mask;
+    pthread_sigmask(SIG_SETMASK, NULL, &wait_mask);
+    sigdelset(&wait_mask, SIGINT);
+    sigdelset(&wait_mask, SIGTERM);
+
+    ListErrorCode code = LIST_SUCCESS;
+    while (code == LIST_SUCCESS && watch->active > 0 && !watch_stop_requested) {
+        struct pollfd pfd = {watch->fd, POLLIN, 0};
+        if (ppoll(&pfd, 1, NULL, &wait_mask) < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Could not wait for events: %s\n", strerror(errno));
+            code = LIST_ERR_READ_DIR;
+            break;
+        }
+
+        // Пачка - все события, накопившиеся к моменту пробуждения
+        for (;;) {
+            ssize_t len = read(watch->fd, buf, WATCH_EVENT_BUFFER_SIZE);
+            if (len < 0) {
+                if (errno != EAGAIN && errno != EINTR) {
+                    fprintf(stderr, "Could not read events: %s\n", strerror(errno));
+                    code = LIST_ERR_READ_DIR;
+                }
+                break;
+            }
+            if (!QueueEvents(watch, buf, (size_t)len)) {
+                fprintf(stderr, "Memory allocation failed\n");
+                code = LIST_ERR_MEMORY;
+                break;
+            }
+        }
+        for (size_t i = 0; code == LIST_SUCCESS && i < watch->dir_count; i++) {
+            code = FlushDirectory(watch, &watch->dirs[i], sink);
+        }
+    }
+    free(buf);
+    return code;
+}
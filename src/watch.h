@@ -0,0 +1,51 @@
+#pragma once
+
+#include <signal.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+#include "entry_store.h"
+#include "listing.h"
+#include "ls.h"
+
+// Watch mode (--watch): directories are listed once and then followed through inotify
+// Every watched directory keeps an index of its visible entries keyed by name;
+// an event only marks its name, and after each batch of events just the marked names
+// are stat'ed again and compared with the index, so the work per batch depends on
+// the number of changed names and not on the size of the directory
+// "." and ".." are not followed; a lost event queue (IN_Q_OVERFLOW) rescans the directories
+
+typedef enum WatchChange {
+    WATCH_ADDED,
+    WATCH_REMOVED,   // The entry carries the last known data
+    WATCH_CHANGED,   // Only reported when the visitor needs stat data
+} WatchChange;
+
+// Receiver of the changes of one directory after a batch of events: entries in
+// output order of args (sort, -r) with kinds[i] describing entries[i]
+typedef struct WatchSink {
+    ListErrorCode (*changes)(void *ctx, const char *path, const FileEntry *const *entries, const WatchChange *kinds, size_t count);
+    void *ctx;
+} WatchSink;
+
+typedef struct DirWatch DirWatch;
+
+// Start an inotify instance; returns NULL with a message on stderr if it is not available
+DirWatch *NewDirWatch(const ListArgs *args);
+void FreeDirWatch(DirWatch *watch);
+
+// Subscribe to the directory, then list it through the visitor (as VisitDirectoryEntries
+// does) while building its index. need_stat and link_targets of the visitor also decide
+// what the index keeps and whether attribute changes are reported
+ListErrorCode AddWatchedDirectory(DirWatch *watch, const char *path, const struct stat *dir_stat, StatEngines *engines,
+                                  const ListVisitor *visitor);
+
+// Set from a signal handler to end RunDirWatch; it is checked before every wait
+extern volatile sig_atomic_t watch_stop_requested;
+
+// Wait for events and hand the changes to the sink until every watched directory
+// is gone or watch_stop_requested is set
+// SIGINT and SIGTERM are unblocked only while waiting (ppoll), so when the caller keeps
+// them blocked otherwise, one that arrives while events are read or reported stays
+// pending until the next wait instead of being lost
+ListErrorCode RunDirWatch(DirWatch *watch, const WatchSink *sink);
@@ -0,0 +1,147 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/ls.h"
+#include "tests.h"
+
+// Ожидаемые значения получены из GNU ls -lh и ls -l --si на файлах этих размеров
+typedef struct SizeCase {
+    unsigned long long size;
+    const char *binary;  // -h
+    const char *si;      // --si
+} SizeCase;
+
+static const SizeCase gnu_cases[] = {
+    {0, "0", "0"},
+    {1, "1", "1"},
+    {999, "999", "999"},
+    {1000, "1000", "1.0k"},
+    {1001, "1001", "1.1k"},
+    {1023, "1023", "1.1k"},
+    {1024, "1.0K", "1.1k"},
+    {1025, "1.1K", "1.1k"},
+    {1536, "1.5K", "1.6k"},
+    {9949, "9.8K", "10k"},
+    {9950, "9.8K", "10k"},
+    {9951, "9.8K", "10k"},
+    {9999, "9.8K", "10k"},
+    {10000, "9.8K", "10k"},
+    {10188, "10K", "11k"},
+    {10189, "10K", "11k"},
+    {10239, "10K", "11k"},
+    {10240, "10K", "11k"},
+    {10241, "11K", "11k"},
+    {10752, "11K", "11k"},
+    {99999, "98K", "100k"},
+    {100000, "98K", "100k"},
+    {102400, "100K", "103k"},
+    {999499, "977K", "1.0M"},
+    {999500, "977K", "1.0M"},
+    {999999, "977K", "1.0M"},
+    {1000000, "977K", "1.0M"},
+    {1000001, "977K", "1.1M"},
+    {1047552, "1023K", "1.1M"},
+    {1048575, "1.0M", "1.1M"},
+    {1048576, "1.0M", "1.1M"},
+    {1048577, "1.1M", "1.1M"},
+    {1572864, "1.5M", "1.6M"},
+    {10485759, "10M", "11M"},
+    {10485760, "10M", "11M"},
+    {1073741823, "1.0G", "1.1G"},
+    {1073741824, "1.0G", "1.1G"},
+    {1099511627776ULL, "1.0T", "1.1T"},
+};
+
+// Правило GNU human_readable в точной арифметике: с одним знаком после точки
+// значение округляется вверх до десятых, иначе вверх до целого; достигнутое
+// основание переходит в следующую единицу
+static void FormatReference(char *buf, size_t size, unsigned long long value, bool si) {
+    const unsigned int base = si ? 1000 : 1024;
+    const char *units = si ? "kMGTPE" : "KMGTPE";
+    if (value < base) {
+        snprintf(buf, size, "%llu", value);
+        return;
+    }
+    int exponent = 0;
+    unsigned __int128 scale = 1;
+    while (exponent < 6 && value / (scale * base) > 0) {
+        scale *= base;
+        exponent++;
+    }
+    unsigned __int128 tenths = ((unsigned __int128)value * 10 + scale - 1) / scale;
+    if (tenths < 100) {
+        snprintf(buf, size, "%u.%u%c", (unsigned)(tenths / 10), (unsigned)(tenths % 10), units[exponent - 1]);
+        return;
+    }
+    unsigned long long amount = (unsigned long long)(((unsigned __int128)value + scale - 1) / scale);
+    if (amount == base && exponent < 6) {
+        snprintf(buf, size, "1.0%c", units[exponent]);
+    } else {
+        snprintf(buf, size, "%llu%c", amount, units[exponent - 1]);
+    }
+}
+
+static void CheckSize(unsigned long long value, bool si, const char *expected) {
+    char buf[HUMAN_SIZE_MAX];
+    size_t len = FormatSize(buf, value, si);
+    ck_assert_msg(strcmp(buf, expected) == 0, "%s %llu: \"%s\" != \"%s\"", si ? "--si" : "-h", value, buf, expected);
+    ck_assert_uint_eq(len, strlen(expected));
+}
+
+static void CheckAgainstReference(unsigned long long value, bool si) {
+    char expected[64];
+    FormatReference(expected, sizeof(expected), value, si);
+    CheckSize(value, si, expected);
+}
+
+
+START_TEST(test_gnu_boundaries) {
+    for (size_t i = 0; i < sizeof(gnu_cases) / sizeof(gnu_cases[0]); i++) {
+        CheckSize(gnu_cases[i].size, false, gnu_cases[i].binary);
+        CheckSize(gnu_cases[i].size, true, gnu_cases[i].si);
+    }
+}
+END_TEST
+
+// Окрестности каждой степени основания и значений, где округление дает 10 и base
+START_TEST(test_rounding_neighbourhoods) {
+    for (int si = 0; si <= 1; si++) {
+        unsigned long long base = si ? 1000 : 1024;
+        for (unsigned long long scale = 1; scale <= (1ULL << 60) / 4; scale *= base) {
+            const unsigned long long points[] = {scale, scale * 10 - scale / 20, scale * 10, scale * base};
+            for (size_t p = 0; p < sizeof(points) / sizeof(points[0]); p++) {
+                unsigned long long from = points[p] > 2048 ? points[p] - 2048 : 0;
+                for (unsigned long long value = from; value <= points[p] + 2048; value++) {
+                    CheckAgainstReference(value, si);
+                }
+            }
+        }
+    }
+}
+END_TEST
+
+// Все размеры до 4 МиБ и крайние значения unsigned long long
+START_TEST(test_exhaustive_small_and_extremes) {
+    for (unsigned long long value = 0; value < (4ULL << 20); value++) {
+        CheckAgainstReference(value, false);
+        CheckAgainstReference(value, true);
+    }
+    for (unsigned long long value = ~0ULL - 4096; value != 0; value++) {
+        CheckAgainstReference(value, false);
+        CheckAgainstReference(value, true);
+    }
+}
+END_TEST
+
+
+Suite *FormatSizeSuite(void) {
+    Suite *suite = suite_create("format_size");
+    TCase *tcase = tcase_create("core");
+    tcase_set_timeout(tcase, 30);
+    tcase_add_test(tcase, test_gnu_boundaries);
+    tcase_add_test(tcase, test_rounding_neighbourhoods);
+    tcase_add_test(tcase, test_exhaustive_small_and_extremes);
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
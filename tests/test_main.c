@@ -0,0 +1,15 @@
+#include <stdlib.h>
+
+#include "tests.h"
+
+int main(void) {
+    SRunner *runner = srunner_create(TimeFormatSuite());
+    srunner_add_suite(runner, FormatSizeSuite());
+    srunner_add_suite(runner, RecordsSuite());
+    srunner_add_suite(runner, VectorSuite());
+
+    srunner_run_all(runner, CK_NORMAL);
+    int failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,115 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../src/ls.h"
+#include "../src/outbuf.h"
+#include "../src/records.h"
+#include "../src/vector.h"
+#include "tests.h"
+
+// Значения по умолчанию, как в main.c
+#define ARGS(...) {.sort = SORT_NAME, .jobs = 1, .timeStyle = TIME_STYLE_DEFAULT, __VA_ARGS__}
+
+// Запись jsonl одного пути в память; результат освобождает вызывающий
+static char *RenderRecord(const char *path, const char *target) {
+    char *text = NULL;
+    size_t text_len = 0;
+    FILE *mem = open_memstream(&text, &text_len);
+    ck_assert_ptr_nonnull(mem);
+    OutBuf ob;
+    ck_assert(InitOutBuf(&ob, mem));
+
+    ListArgs args = ARGS(.format = FORMAT_JSONL);
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    OutRecord(&ob, &args, path, &st, target, target ? strlen(target) : 0);
+    FreeOutBuf(&ob);
+    fclose(mem);
+    return text;
+}
+
+
+START_TEST(test_utf8_validation) {
+    ck_assert(IsValidUtf8("", 0));
+    ck_assert(IsValidUtf8("plain.txt", 9));
+    ck_assert(IsValidUtf8("caf\xc3\xa9", 5));
+    ck_assert(IsValidUtf8("\xe2\x82\xac", 3));          // U+20AC
+    ck_assert(IsValidUtf8("\xf0\x9f\x98\x80", 4));      // U+1F600
+    ck_assert(IsValidUtf8("\xf4\x8f\xbf\xbf", 4));      // U+10FFFF
+
+    ck_assert(!IsValidUtf8("bad\xff", 4));
+    ck_assert(!IsValidUtf8("\x80", 1));                 // Продолжение без начала
+    ck_assert(!IsValidUtf8("\xc0\xaf", 2));             // Избыточная кодировка '/'
+    ck_assert(!IsValidUtf8("\xe0\x80\xaf", 3));
+    ck_assert(!IsValidUtf8("\xed\xa0\x80", 3));         // Суррогат U+D800
+    ck_assert(!IsValidUtf8("\xf4\x90\x80\x80", 4));     // Выше U+10FFFF
+    ck_assert(!IsValidUtf8("\xe2\x82", 2));             // Обрыв последовательности
+    ck_assert(!IsValidUtf8("\xe2\x82\xac", 2));
+}
+END_TEST
+
+START_TEST(test_valid_names_unchanged) {
+    char *text = RenderRecord("caf\xc3\xa9 \"q\"\\", "\xe2\x82\xac");
+    ck_assert_msg(strstr(text, "\"path\":\"caf\xc3\xa9 \\\"q\\\"\\\\\",") != NULL, "%s", text);
+    ck_assert_msg(strstr(text, "\"target\":\"\xe2\x82\xac\"}") != NULL, "%s", text);
+    ck_assert_msg(strstr(text, "_escaped") == NULL, "%s", text);
+    free(text);
+}
+END_TEST
+
+// Не-UTF-8 строка выводится побайтно целиком, включая ее корректные последовательности
+START_TEST(test_invalid_names_escaped) {
+    char *text = RenderRecord("caf\xc3\xa9\xff", "t\xfe");
+    ck_assert_msg(strstr(text, "\"path\":\"caf\\u00c3\\u00a9\\u00ff\",\"path_escaped\":true,") != NULL, "%s", text);
+    ck_assert_msg(strstr(text, "\"target\":\"t\\u00fe\",\"target_escaped\":true}") != NULL, "%s", text);
+    ck_assert(IsValidUtf8(text, strlen(text)));
+    free(text);
+}
+END_TEST
+
+// Листинг настоящей директории с файлом, имя которого не является UTF-8
+START_TEST(test_listing_non_utf8_file) {
+    char dir[] = "/tmp/hw2_records_XXXXXX";
+    ck_assert_ptr_nonnull(mkdtemp(dir));
+    char file[sizeof(dir) + 16];
+    snprintf(file, sizeof(file), "%s/bad\xff\xfename", dir);
+    FILE *created = fopen(file, "w");
+    ck_assert_ptr_nonnull(created);
+    fclose(created);
+
+    GenericVector *paths = NewArenaVector(1);
+    ck_assert_ptr_nonnull(paths);
+    ck_assert_ptr_nonnull(AppendString(paths, dir, strlen(dir)));
+    char *text = NULL;
+    size_t text_len = 0;
+    FILE *mem = open_memstream(&text, &text_len);
+    ck_assert_ptr_nonnull(mem);
+    ListArgs args = ARGS(.format = FORMAT_JSONL);
+    ListErrorCode code = ListPaths(paths, &args, mem);
+    fclose(mem);
+    unlink(file);
+    rmdir(dir);
+    FreeGenericVector(paths);
+
+    ck_assert_int_eq(code, LIST_SUCCESS);
+    ck_assert_msg(IsValidUtf8(text, text_len), "%s", text);
+    ck_assert_msg(strstr(text, "/bad\\u00ff\\u00fename\",\"path_escaped\":true,") != NULL, "%s", text);
+    free(text);
+}
+END_TEST
+
+
+Suite *RecordsSuite(void) {
+    Suite *suite = suite_create("records");
+    TCase *tcase = tcase_create("core");
+    tcase_add_test(tcase, test_utf8_validation);
+    tcase_add_test(tcase, test_valid_names_unchanged);
+    tcase_add_test(tcase, test_invalid_names_escaped);
+    tcase_add_test(tcase, test_listing_non_utf8_file);
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
@@ -0,0 +1,137 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/timefmt.h"
+#include "tests.h"
+
+// Полгода по определению GNU ls, как в src/timefmt.c
+#define SIX_MONTHS (31556952 / 2)
+// Запас вокруг границ, чтобы ход часов во время теста не менял ожидаемый результат
+#define CLOCK_MARGIN 10
+
+static time_t Now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec;
+}
+
+// Прежний путь через localtime_r и strftime; recent - правило GNU ls для now
+static void FormatReference(char *buf, size_t size, const struct timespec *when, TimeStyle style, time_t now) {
+    bool recent = when->tv_sec > now - SIX_MONTHS && when->tv_sec <= now;
+    struct tm tm;
+    ck_assert(localtime_r(&when->tv_sec, &tm) != NULL);
+    switch (style) {
+        case TIME_STYLE_DEFAULT:
+            strftime(buf, size, "%b %e %H:%M", &tm);
+            break;
+        case TIME_STYLE_LOCALE:
+            strftime(buf, size, recent ? "%b %e %H:%M" : "%b %e  %Y", &tm);
+            break;
+        case TIME_STYLE_ISO:
+            strftime(buf, size, recent ? "%m-%d %H:%M" : "%Y-%m-%d ", &tm);
+            break;
+        case TIME_STYLE_LONG_ISO:
+            strftime(buf, size, "%Y-%m-%d %H:%M", &tm);
+            break;
+        default: {
+            char date[32], zone[8];
+            strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+            strftime(zone, sizeof(zone), "%z", &tm);
+            snprintf(buf, size, "%s.%09ld %s", date, when->tv_nsec, zone);
+            break;
+        }
+    }
+}
+
+static void CheckTimestamp(time_t sec, long nsec, TimeStyle style, time_t now) {
+    struct timespec when = {sec, nsec};
+    char expected[TIMESTAMP_MAX], actual[TIMESTAMP_MAX];
+    FormatReference(expected, sizeof(expected), &when, style, now);
+    size_t len = FormatTimestamp(actual, sizeof(actual), &when, style, NULL);
+    ck_assert_msg(strcmp(actual, expected) == 0, "style %d, time %lld: \"%s\" != \"%s\"", (int)style, (long long)sec,
+                  actual, expected);
+    ck_assert_uint_eq(len, strlen(expected));
+}
+
+static bool NearBoundary(time_t sec, time_t now) {
+    time_t old = now - SIX_MONTHS;
+    return (sec > old - CLOCK_MARGIN && sec < old + CLOCK_MARGIN) || (sec > now - CLOCK_MARGIN && sec < now + CLOCK_MARGIN);
+}
+
+static const TimeStyle styles[] = {
+    TIME_STYLE_DEFAULT, TIME_STYLE_LOCALE, TIME_STYLE_ISO, TIME_STYLE_LONG_ISO, TIME_STYLE_FULL_ISO,
+};
+
+
+// Все встроенные стили совпадают со strftime на нескольких годах вокруг текущего времени
+START_TEST(test_styles_match_strftime) {
+    time_t now = Now();
+    for (time_t sec = now - 3 * 366 * 86400L; sec < now + 366 * 86400L; sec += 3607) {
+        if (NearBoundary(sec, now)) continue;
+        for (size_t i = 0; i < sizeof(styles) / sizeof(styles[0]); i++) {
+            CheckTimestamp(sec, (long)(sec % 1000000000L), styles[i], now);
+        }
+    }
+}
+END_TEST
+
+// Граница в полгода: чуть позже нее - время, чуть раньше - год
+START_TEST(test_six_month_boundary) {
+    time_t now = Now();
+    time_t old = now - SIX_MONTHS;
+    for (size_t i = 0; i < sizeof(styles) / sizeof(styles[0]); i++) {
+        CheckTimestamp(old + CLOCK_MARGIN, 0, styles[i], now);
+        CheckTimestamp(old - CLOCK_MARGIN, 0, styles[i], now);
+    }
+
+    char recent[TIMESTAMP_MAX], old_file[TIMESTAMP_MAX];
+    struct timespec inside = {old + CLOCK_MARGIN, 0}, outside = {old - CLOCK_MARGIN, 0};
+    FormatTimestamp(recent, sizeof(recent), &inside, TIME_STYLE_LOCALE, NULL);
+    FormatTimestamp(old_file, sizeof(old_file), &outside, TIME_STYLE_LOCALE, NULL);
+    ck_assert_msg(strchr(recent, ':') != NULL, "\"%s\" should show the time", recent);
+    ck_assert_msg(strchr(old_file, ':') == NULL, "\"%s\" should show the year", old_file);
+}
+END_TEST
+
+// Метка из будущего выводится с годом
+START_TEST(test_future_timestamp) {
+    time_t now = Now();
+    for (size_t i = 0; i < sizeof(styles) / sizeof(styles[0]); i++) {
+        CheckTimestamp(now + 3600, 0, styles[i], now);
+    }
+    char buf[TIMESTAMP_MAX];
+    struct timespec future = {now + 3600, 0};
+    FormatTimestamp(buf, sizeof(buf), &future, TIME_STYLE_LOCALE, NULL);
+    ck_assert_msg(strchr(buf, ':') == NULL, "\"%s\" should show the year", buf);
+}
+END_TEST
+
+// Файл, созданный после первого вывода, становится недавним, а не будущим:
+// текущее время перечитывается для меток из будущего (долгий --watch)
+START_TEST(test_clock_refreshed_for_future) {
+    char buf[TIMESTAMP_MAX];
+    struct timespec first = {Now(), 0};
+    FormatTimestamp(buf, sizeof(buf), &first, TIME_STYLE_LOCALE, NULL);
+
+    struct timespec created = {Now() + 1, 0};
+    struct timespec pause = {1, 500000000L};
+    nanosleep(&pause, NULL);
+    FormatTimestamp(buf, sizeof(buf), &created, TIME_STYLE_LOCALE, NULL);
+    ck_assert_msg(strchr(buf, ':') != NULL, "\"%s\" should show the time", buf);
+}
+END_TEST
+
+
+Suite *TimeFormatSuite(void) {
+    Suite *suite = suite_create("timefmt");
+    TCase *tcase = tcase_create("core");
+    tcase_set_timeout(tcase, 30);
+    tcase_add_test(tcase, test_styles_match_strftime);
+    tcase_add_test(tcase, test_six_month_boundary);
+    tcase_add_test(tcase, test_future_timestamp);
+    tcase_add_test(tcase, test_clock_refreshed_for_future);
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
@@ -0,0 +1,68 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../src/vector.h"
+#include "tests.h"
+
+// Вектор из count строк арены, первая - prefix
+static GenericVector *FilledVector(const char *prefix, size_t count) {
+    GenericVector *vector = NewArenaVector(0);
+    ck_assert_ptr_nonnull(vector);
+    for (size_t i = 0; i < count; i++) {
+        ck_assert_ptr_nonnull(AppendString(vector, prefix, 1));
+    }
+    return vector;
+}
+
+
+START_TEST(test_extend_keeps_reserved_array) {
+    GenericVector *dest = NewArenaVector(16);
+    ck_assert_ptr_nonnull(dest);
+    void **reserved = GetData(dest);
+    GenericVector *first = FilledVector("a", 5);
+    GenericVector *second = FilledVector("b", 7);
+
+    ck_assert(Extend(dest, first));
+    ck_assert(Extend(dest, second));
+    // Оба источника скопированы в массив, зарезервированный заранее
+    ck_assert_ptr_eq(GetData(dest), reserved);
+    ck_assert_uint_eq(GetLength(dest), 12);
+    ck_assert_str_eq((const char *)GetElement(dest, 0), "a");
+    ck_assert_str_eq((const char *)GetElement(dest, 11), "b");
+    ck_assert(IsEmpty(first));
+    ck_assert(IsEmpty(second));
+
+    FreeGenericVector(first);
+    FreeGenericVector(second);
+    FreeGenericVector(dest);
+}
+END_TEST
+
+START_TEST(test_extend_takes_array_without_capacity) {
+    GenericVector *dest = NewArenaVector(0);
+    ck_assert_ptr_nonnull(dest);
+    GenericVector *source = FilledVector("a", 9);
+    void **source_arr = GetData(source);
+
+    ck_assert(Extend(dest, source));
+    ck_assert_ptr_eq(GetData(dest), source_arr);
+    ck_assert_uint_eq(GetLength(dest), 9);
+    ck_assert(IsEmpty(source));
+    // Источник остается пригодным для повторного заполнения
+    ck_assert_ptr_nonnull(AppendString(source, "c", 1));
+
+    FreeGenericVector(source);
+    ck_assert_str_eq((const char *)GetElement(dest, 8), "a");
+    FreeGenericVector(dest);
+}
+END_TEST
+
+
+Suite *VectorSuite(void) {
+    Suite *suite = suite_create("vector");
+    TCase *tcase = tcase_create("core");
+    tcase_add_test(tcase, test_extend_keeps_reserved_array);
+    tcase_add_test(tcase, test_extend_takes_array_without_capacity);
+    suite_add_tcase(suite, tcase);
+    return suite;
+}
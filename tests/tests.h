@@ -0,0 +1,9 @@
+#pragma once
+
+#include <check.h>
+
+// Test suites of the modules, run together by tests/test_main.c
+Suite *TimeFormatSuite(void);
+Suite *FormatSizeSuite(void);
+Suite *RecordsSuite(void);
+Suite *VectorSuite(void);